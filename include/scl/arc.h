@@ -0,0 +1,377 @@
+#pragma once
+
+#include "sync_send.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Biased reference counting (Choi, Shull & Torrellas, PACT '18)
+//
+// Every block is "biased" towards the thread that created it. The owner
+// increments and decrements a plain, non-atomic counter so copying and
+// dropping arcs on the owner thread never issues an atomic RMW.
+// All other threads use an atomic "shared" counter which is allowed to go
+// negative (e.g. when a copy made on the owner is dropped on a worker).
+//
+// The true reference count is biased + shared. As only the owner can read
+// the biased count, it has to "merge" the two when either:
+// - The biased count drops to zero
+// - A foreign thread makes the shared count negative. The block is then
+//   queued on the owner who merges it the next time it creates or drops an
+//   arc, or when the owner thread exits
+//
+// Once merged the block behaves like a normal atomically counted pointer.
+// N.B. This means destruction of a block released by a foreign thread can be
+// deferred until the owner next uses an arc.
+
+namespace scl {
+
+namespace detail {
+
+//==========================================
+struct arc_block_base
+{
+    // shared word layout: (count << 2) | queued | merged
+    static constexpr std::int64_t merged_flag = 1;
+    static constexpr std::int64_t queued_flag = 2;
+    static constexpr std::int64_t count_one   = 4;
+
+    static constexpr std::int64_t count_of (std::int64_t shared) { return shared >> 2; }
+
+    arc_block_base()
+        : origin_id (std::this_thread::get_id()),
+          owner_id (origin_id)
+    {
+    }
+
+    virtual ~arc_block_base() = default;
+
+    const std::thread::id origin_id;
+    std::atomic<std::thread::id> owner_id;  // Reset to none when merged
+    std::atomic<std::int64_t> shared { 0 };
+
+    // Owner thread only
+    std::size_t biased = 1;
+    arc_block_base* prev = nullptr;
+    arc_block_base* next = nullptr;
+};
+
+//==========================================
+struct arc_owner_state;
+
+struct arc_registry
+{
+    static arc_registry& get()
+    {
+        // Leaked so it outlives any thread_local arc_owner_state
+        static auto registry = new arc_registry();
+        return *registry;
+    }
+
+    std::mutex mutex;
+    std::unordered_map<std::thread::id, arc_owner_state*> owners;
+};
+
+//==========================================
+struct arc_owner_state
+{
+    arc_owner_state()
+    {
+        auto& registry = arc_registry::get();
+        std::scoped_lock _ (registry.mutex);
+        registry.owners[std::this_thread::get_id()] = this;
+    }
+
+    ~arc_owner_state()
+    {
+        // Give up the bias on everything this thread still owns so foreign
+        // threads can finish the count atomically
+        auto& registry = arc_registry::get();
+        std::scoped_lock _ (registry.mutex);
+
+        for (auto block : std::exchange (queue, {}))
+            process_queued (*block);
+
+        while (owned)
+        {
+            auto block = owned;
+            const auto shared = merge (*block);
+
+            if (arc_block_base::count_of (shared) == 0
+                && ! (shared & arc_block_base::queued_flag))
+                delete block;
+        }
+
+        has_queued.store (false, std::memory_order_relaxed);
+        registry.owners.erase (std::this_thread::get_id());
+    }
+
+    void link (arc_block_base& block)
+    {
+        block.next = owned;
+
+        if (owned)
+            owned->prev = &block;
+
+        owned = &block;
+    }
+
+    void unlink (arc_block_base& block)
+    {
+        if (block.prev)
+            block.prev->next = block.next;
+        else
+            owned = block.next;
+
+        if (block.next)
+            block.next->prev = block.prev;
+
+        block.prev = block.next = nullptr;
+    }
+
+    /** Folds the biased count in to the shared count and gives up ownership.
+        Returns the new shared word.
+    */
+    std::int64_t merge (arc_block_base& block)
+    {
+        unlink (block);
+        block.owner_id.store (std::thread::id(), std::memory_order_relaxed);
+
+        const auto biased = static_cast<std::int64_t> (std::exchange (block.biased, 0));
+        auto shared = block.shared.load (std::memory_order_relaxed);
+
+        // acq_rel: synchronises with foreign releases before a possible delete
+        while (! block.shared.compare_exchange_weak (shared, (shared + biased * arc_block_base::count_one)
+                                                             | arc_block_base::merged_flag,
+                                                     std::memory_order_acq_rel))
+        {}
+
+        return (shared + biased * arc_block_base::count_one) | arc_block_base::merged_flag;
+    }
+
+    /** Called on the owner when a block it previously queued is taken off
+        the queue or by a foreign thread if the block has already been merged.
+    */
+    void process_queued (arc_block_base& block)
+    {
+        if (! (block.shared.load (std::memory_order_relaxed) & arc_block_base::merged_flag))
+            merge (block);
+
+        finish_queued (block);
+    }
+
+    static void finish_queued (arc_block_base& block)
+    {
+        const auto shared = block.shared.fetch_and (~arc_block_base::queued_flag, std::memory_order_acq_rel)
+                                & ~arc_block_base::queued_flag;
+
+        if (arc_block_base::count_of (shared) == 0)
+            delete &block;
+    }
+
+    void drain()
+    {
+        if (! has_queued.load (std::memory_order_relaxed))
+            return;
+
+        std::vector<arc_block_base*> blocks;
+
+        {
+            std::scoped_lock _ (arc_registry::get().mutex);
+            blocks = std::exchange (queue, {});
+            has_queued.store (false, std::memory_order_relaxed);
+        }
+
+        for (auto block : blocks)
+            process_queued (*block);
+    }
+
+    std::atomic<bool> has_queued { false };
+    std::vector<arc_block_base*> queue;  // Guarded by the registry mutex
+    arc_block_base* owned = nullptr;
+};
+
+inline arc_owner_state& this_thread_arc_state()
+{
+    thread_local arc_owner_state state;
+    return state;
+}
+
+//==========================================
+inline bool is_owner (const arc_block_base& block)
+{
+    return block.owner_id.load (std::memory_order_relaxed) == std::this_thread::get_id();
+}
+
+inline void enqueue (arc_block_base& block)
+{
+    auto& registry = arc_registry::get();
+    std::scoped_lock _ (registry.mutex);
+
+    // If the owner has exited it will have merged the block, so finish it here
+    if (block.shared.load (std::memory_order_relaxed) & arc_block_base::merged_flag)
+        return arc_owner_state::finish_queued (block);
+
+    auto owner = registry.owners.at (block.origin_id);
+    owner->queue.push_back (&block);
+    owner->has_queued.store (true, std::memory_order_relaxed);
+}
+
+inline void acquire (arc_block_base& block)
+{
+    if (is_owner (block))
+        ++block.biased;
+    else
+        block.shared.fetch_add (arc_block_base::count_one, std::memory_order_relaxed);
+}
+
+inline void release (arc_block_base& block)
+{
+    if (is_owner (block))
+    {
+        auto& state = this_thread_arc_state();
+
+        if (--block.biased == 0)
+        {
+            const auto shared = state.merge (block);
+
+            if (arc_block_base::count_of (shared) == 0
+                && ! (shared & arc_block_base::queued_flag))
+                delete &block;
+        }
+
+        state.drain();
+        return;
+    }
+
+    auto shared = block.shared.load (std::memory_order_relaxed);
+
+    for (;;)
+    {
+        auto desired = shared - arc_block_base::count_one;
+        const bool needs_queueing = ! (shared & (arc_block_base::merged_flag | arc_block_base::queued_flag))
+                                     && arc_block_base::count_of (desired) < 0;
+
+        if (needs_queueing)
+            desired |= arc_block_base::queued_flag;
+
+        // acq_rel: release our accesses to the owner/deleter, acquire theirs if we delete
+        if (block.shared.compare_exchange_weak (shared, desired, std::memory_order_acq_rel))
+        {
+            if (needs_queueing)
+                enqueue (block);
+            else if ((desired & arc_block_base::merged_flag)
+                     && ! (desired & arc_block_base::queued_flag)
+                     && arc_block_base::count_of (desired) == 0)
+                delete &block;
+
+            return;
+        }
+    }
+}
+
+//==========================================
+template<typename T>
+struct arc_block : arc_block_base
+{
+    template<typename... Args>
+    arc_block (Args&&... args)
+        : value (std::forward<Args> (args)...)
+    {}
+
+    T value;
+};
+
+}
+
+//==========================================
+//==========================================
+/**
+ *  An atomically reference counted pointer to a sync object, similar to
+ *  Rust's Arc.
+ *
+ *  Only sync types can be shared this way as every copy can be used
+ *  concurrently on different threads. arc itself is send so can be passed
+ *  to scl::thread by value.
+ *
+ *  Unlike std::shared_ptr, copies made and dropped on the thread that created
+ *  the object don't use atomic RMWs. See the notes on biased reference
+ *  counting at the top of this file.
+ */
+template<sync T>
+class arc
+{
+public:
+    arc (const arc& other)
+        : block (other.block)
+    {
+        if (block)
+            detail::acquire (*block);
+    }
+
+    arc (arc&& other) noexcept
+        : block (std::exchange (other.block, nullptr))
+    {
+    }
+
+    arc& operator= (const arc& other)
+    {
+        arc (other).swap (*this);
+        return *this;
+    }
+
+    arc& operator= (arc&& other) noexcept
+    {
+        arc (std::move (other)).swap (*this);
+        return *this;
+    }
+
+    ~arc()
+    {
+        if (block)
+            detail::release (*block);
+    }
+
+    void swap (arc& other) noexcept
+    {
+        std::swap (block, other.block);
+    }
+
+    T& operator*() const                { return block->value; }
+    T* operator->() const               { return &block->value; }
+    T* get() const                      { return block ? &block->value : nullptr; }
+    explicit operator bool() const      { return block != nullptr; }
+
+    template<sync U, typename... Args>
+    friend arc<U> make_arc (Args&&...);
+
+private:
+    explicit arc (detail::arc_block<T>* b)
+        : block (b)
+    {
+    }
+
+    detail::arc_block<T>* block = nullptr;
+};
+
+/** Creates an arc owned (biased towards) the calling thread. */
+template<sync T, typename... Args>
+arc<T> make_arc (Args&&... args)
+{
+    auto& state = detail::this_thread_arc_state();
+    state.drain();
+
+    auto block = new detail::arc_block<T> (std::forward<Args> (args)...);
+    state.link (*block);
+
+    return arc<T> (block);
+}
+
+template<typename T>
+struct is_send<arc<T>> : std::true_type {};
+
+}
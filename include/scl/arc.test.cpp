@@ -0,0 +1,132 @@
+#include <cassert>
+#include <ranges>
+#include <string>
+#include <vector>
+#include "arc.h"
+#include "safe_thread.h"
+#include "synchronized_value.h"
+
+struct counted
+{
+    counted()   { ++num_alive; }
+    ~counted()  { --num_alive; }
+
+    std::atomic<int> value { 0 };
+    static inline std::atomic<int> num_alive { 0 };
+};
+
+template<>
+struct scl::is_sync<counted> : std::true_type {};
+
+static_assert(scl::is_send_v<scl::arc<counted>>);
+static_assert(scl::is_send_v<scl::arc<scl::synchronized_value<std::string>>>);
+
+void test_single_thread()
+{
+    {
+        auto a = scl::make_arc<counted>();
+        a->value = 42;
+        assert(counted::num_alive == 1);
+
+        {
+            auto b = a;
+            auto c = std::move (b);
+            assert(! b);
+            assert(c.get() == a.get());
+        }
+
+        assert(a->value == 42);
+        assert(counted::num_alive == 1);
+    }
+
+    assert(counted::num_alive == 0);
+}
+
+void increment (scl::arc<counted> c)
+{
+    ++c->value;
+}
+
+void test_threads()
+{
+    constexpr int num_threads = 8;
+
+    {
+        auto a = scl::make_arc<counted>();
+
+        {
+            std::vector<scl::thread> threads;
+
+            for ([[maybe_unused]] auto i : std::views::iota (0, num_threads))
+                threads.push_back (scl::thread (increment, auto (a)));
+        }
+
+        assert(a->value == num_threads);
+    }
+
+    // Owner dropped the last reference so the block is merged and freed
+    assert(counted::num_alive == 0);
+
+    // Owner drops its reference first, the workers are left to merge
+    {
+        std::vector<scl::thread> threads;
+
+        {
+            auto a = scl::make_arc<counted>();
+
+            for ([[maybe_unused]] auto i : std::views::iota (0, num_threads))
+                threads.push_back (scl::thread (increment, auto (a)));
+        }
+    }
+
+    // Destruction is deferred to the owner's next use of an arc
+    [[maybe_unused]] auto next = scl::make_arc<counted>();
+    assert(counted::num_alive == 1);
+}
+
+void test_owner_exit()
+{
+    std::vector<scl::arc<counted>> arcs;
+
+    // The owner thread exits while main still holds references
+    std::thread owner ([&]
+                       {
+                           auto a = scl::make_arc<counted>();
+                           arcs.push_back (a);
+                           arcs.push_back (a);
+                       });
+    owner.join();
+
+    assert(counted::num_alive == 1);
+    arcs.pop_back();
+    assert(counted::num_alive == 1);
+    arcs.pop_back();
+    assert(counted::num_alive == 0);
+}
+
+void append (scl::arc<scl::synchronized_value<std::string>> s)
+{
+    apply ([] (auto& str) { str.append ("!"); }, *s);
+}
+
+void test_synchronized_value()
+{
+    auto s = scl::make_arc<scl::synchronized_value<std::string>> ("Hello");
+
+    {
+        std::vector<scl::thread> threads;
+
+        for ([[maybe_unused]] auto i : std::views::iota (0, 4))
+            threads.push_back (scl::thread (append, auto (s)));
+    }
+
+    assert(apply ([] (auto& str) { return str; }, *s) == "Hello!!!!");
+}
+
+int main()
+{
+    test_single_thread();
+    test_threads();
+    test_owner_exit();
+    test_synchronized_value();
+}
@@ -0,0 +1,296 @@
+#pragma once
+
+#include "execution.h"
+#include "synchronized_value.h"
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <coroutine>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <tuple>
+
+namespace scl {
+
+/**
+ *  A mutex that hands ownership directly to its waiters in FIFO order.
+ *  Waiters are intrusive nodes that are called once they own the mutex, so
+ *  coroutines can wait without blocking a thread, see async_apply.
+ *  It can also be locked by normal threads, which block as usual, so a
+ *  synchronized_value<T, async_mutex> works with apply as well.
+ */
+class async_mutex
+{
+public:
+    /** Queued when the mutex is contended, on_acquired is called once the
+        mutex has been handed over to it.
+    */
+    struct waiter
+    {
+        waiter* next = nullptr;
+        void (*on_acquired) (waiter&) noexcept = nullptr;
+    };
+
+    async_mutex() = default;
+    async_mutex (const async_mutex&) = delete;
+    async_mutex& operator= (const async_mutex&) = delete;
+
+    /** Locks the mutex and returns true if it's free, otherwise queues w
+        and returns false. w then owns the mutex when on_acquired is called.
+    */
+    bool try_lock_or_enqueue (waiter& w)
+    {
+        std::scoped_lock _ (state_mutex);
+
+        if (! locked)
+        {
+            locked = true;
+            return true;
+        }
+
+        w.next = nullptr;
+
+        if (tail)
+            tail->next = &w;
+        else
+            head = &w;
+
+        tail = &w;
+        return false;
+    }
+
+    bool try_lock()
+    {
+        std::scoped_lock _ (state_mutex);
+        return ! std::exchange (locked, true);
+    }
+
+    void lock()
+    {
+        thread_waiter w;
+
+        if (try_lock_or_enqueue (w))
+            return;
+
+        std::unique_lock l (w.mutex);
+        w.condition.wait (l, [&] { return w.acquired; });
+    }
+
+    void unlock()
+    {
+        waiter* next = nullptr;
+
+        {
+            std::scoped_lock _ (state_mutex);
+            next = head;
+
+            if (next)
+            {
+                head = next->next;
+
+                if (! head)
+                    tail = nullptr;
+            }
+            else
+            {
+                locked = false;
+            }
+        }
+
+        // Called without the state lock as it may resume the waiter inline
+        if (next)
+            next->on_acquired (*next);
+    }
+
+private:
+    struct thread_waiter : waiter
+    {
+        thread_waiter()
+        {
+            on_acquired = [] (waiter& w) noexcept
+            {
+                // Notify under the lock as the waiter returns once acquired is set
+                auto& t = static_cast<thread_waiter&> (w);
+                std::scoped_lock _ (t.mutex);
+                t.acquired = true;
+                t.condition.notify_one();
+            };
+        }
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool acquired = false;
+    };
+
+    std::mutex state_mutex;
+    bool locked = false;
+    waiter* head = nullptr;
+    waiter* tail = nullptr;
+};
+
+
+namespace detail {
+/**
+ *  The awaitable returned by async_apply.
+ *  The mutexes are acquired in address order. Each contended one queues a
+ *  waiter and suspends; when the mutex is handed over the coroutine is
+ *  scheduled on sch to carry on acquiring the rest. f is then called on
+ *  resumption and the mutexes unlocked, handing them to the next waiters.
+ */
+template<typename Sch, typename F, typename... Types>
+class async_apply_awaiter
+{
+public:
+    async_apply_awaiter (Sch sch_to_use, F f_to_use, synchronized_value<Types, async_mutex>&... values_to_use)
+        : sch (std::move (sch_to_use)),
+          f (std::move (f_to_use)),
+          values (values_to_use...),
+          mutexes { &values_to_use.mutex... }
+    {
+        std::ranges::sort (mutexes, std::less<>());
+
+        for (std::size_t i = 0; i < num_mutexes; ++i)
+        {
+            waiters[i].owner = this;
+            waiters[i].index = i;
+            waiters[i].on_acquired = [] (async_mutex::waiter& w) noexcept
+            {
+                auto& lw = static_cast<lock_waiter&> (w);
+                lw.owner->acquired (lw.index);
+            };
+        }
+    }
+
+    async_apply_awaiter (const async_apply_awaiter&) = delete;
+    async_apply_awaiter& operator= (const async_apply_awaiter&) = delete;
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    bool await_suspend (std::coroutine_handle<> h) noexcept
+    {
+        continuation = h;
+
+        // N.B. Once queued we may be resumed on another thread so this
+        // mustn't be touched after lock_from returns false
+        return ! lock_from (0);
+    }
+
+    std::invoke_result_t<F, Types&...> await_resume()
+    {
+        struct unlocker
+        {
+            async_apply_awaiter& a;
+
+            ~unlocker()
+            {
+                for (auto m : a.mutexes)
+                    m->unlock();
+            }
+        } _ { *this };
+
+        return std::apply ([this] (auto&... vs)
+                           {
+                               detail::scoped_sync_clocks clocks (vs.clock...);
+                               detail::scoped_held_locks locks (vs.mutex...);
+                               return std::invoke (std::move (f), vs.val...);
+                           }, values);
+    }
+
+private:
+    static constexpr std::size_t num_mutexes = sizeof... (Types);
+
+    struct lock_waiter : async_mutex::waiter
+    {
+        async_apply_awaiter* owner = nullptr;
+        std::size_t index = 0;
+    };
+
+    struct resume_receiver
+    {
+        async_apply_awaiter* owner;
+        std::size_t index;
+
+        void set_value() noexcept
+        {
+            if (owner->lock_from (index + 1))
+                owner->continuation.resume();
+        }
+
+        void set_error (std::exception_ptr) noexcept    { std::terminate(); }
+        void set_stopped() noexcept                     { std::terminate(); }
+    };
+
+    using resume_operation = execution::connect_result_t<execution::schedule_result_t<Sch&>, resume_receiver>;
+
+    /** Lets an immovable operation state be emplaced in an optional. */
+    struct resume_connector
+    {
+        async_apply_awaiter* owner;
+        std::size_t index;
+
+        operator resume_operation() const
+        {
+            return execution::connect (execution::schedule (owner->sch), resume_receiver { owner, index });
+        }
+    };
+
+    Sch sch;
+    F f;
+    std::tuple<synchronized_value<Types, async_mutex>&...> values;
+    std::array<async_mutex*, num_mutexes> mutexes;
+    std::array<lock_waiter, num_mutexes> waiters;
+
+    // One per mutex as a resumption can still be returning when the next
+    // mutex is handed over
+    std::array<std::optional<resume_operation>, num_mutexes> resume_operations;
+    std::coroutine_handle<> continuation;
+
+    /** Locks the mutexes from index onwards, returning false if one had to
+        be waited for.
+    */
+    bool lock_from (std::size_t index)
+    {
+        for (; index < num_mutexes; ++index)
+            if (! mutexes[index]->try_lock_or_enqueue (waiters[index]))
+                return false;
+
+        return true;
+    }
+
+    void acquired (std::size_t index) noexcept
+    {
+        auto& op = resume_operations[index].emplace (resume_connector { this, index });
+        execution::start (op);
+    }
+};
+}
+
+
+/**
+ *  The coroutine equivalent of apply. Locks the values' async_mutexes then
+ *  calls f with them, returning its result:
+ *      auto total = co_await async_apply (pool.get_scheduler(), f, value);
+ *
+ *  If a mutex is held the calling coroutine is suspended rather than its
+ *  thread blocked. The mutex is handed over in FIFO order and the coroutine
+ *  resumed on sch, so a few threads can serve many coroutines sharing state.
+ *
+ *  f is moved or copied into the returned awaitable so it can be stored and
+ *  awaited later, but the values are held by reference so must outlive it.
+ */
+template<execution::scheduler Sch, typename F, typename T, typename... Types>
+    requires std::invocable<std::decay_t<F>, T&, Types&...>
+[[nodiscard]] detail::async_apply_awaiter<std::remove_cvref_t<Sch>, std::decay_t<F>, T, Types...>
+async_apply (Sch&& sch, F&& f, synchronized_value<T, async_mutex>& value, synchronized_value<Types, async_mutex>&... values)
+{
+    return { std::forward<Sch> (sch), std::forward<F> (f), value, values... };
+}
+
+template<>
+struct is_sync<async_mutex> : std::true_type {};
+
+}
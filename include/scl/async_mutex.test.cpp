@@ -0,0 +1,137 @@
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <exception>
+#include <latch>
+#include <ranges>
+#include <thread>
+#include <vector>
+#include "async_mutex.h"
+
+namespace ex = scl::execution;
+
+/** A coroutine that starts immediately and nothing waits on. */
+struct detached
+{
+    struct promise_type
+    {
+        detached get_return_object()                { return {}; }
+        std::suspend_never initial_suspend() noexcept   { return {}; }
+        std::suspend_never final_suspend() noexcept     { return {}; }
+        void return_void()                          {}
+        void unhandled_exception()                  { std::terminate(); }
+    };
+};
+
+static_assert(scl::is_sync_v<scl::synchronized_value<int, scl::async_mutex>>);
+
+detached append (ex::run_loop& loop, scl::synchronized_value<std::vector<int>, scl::async_mutex>& order, int i, int last)
+{
+    co_await async_apply (loop.get_scheduler(), [i] (std::vector<int>& o) { o.push_back (i); }, order);
+
+    if (i == last)
+        loop.finish();
+}
+
+void test_fifo_handover()
+{
+    constexpr int num_waiters = 100;
+    ex::run_loop loop;
+    scl::synchronized_value<std::vector<int>, scl::async_mutex> order;
+    std::latch locked (1), release (1);
+
+    // Hold the lock from a normal thread so every coroutine has to queue
+    std::thread holder ([&]
+                        {
+                            apply ([&] (std::vector<int>&)
+                                   {
+                                       locked.count_down();
+                                       release.wait();
+                                   }, order);
+                        });
+
+    locked.wait();
+
+    for (auto i : std::views::iota (0, num_waiters))
+        append (loop, order, i, num_waiters - 1);
+
+    release.count_down();
+    loop.run();
+    holder.join();
+
+    [[maybe_unused]] const auto result = apply ([] (auto& o) { return o; }, order);
+    assert(std::ranges::equal (result, std::views::iota (0, num_waiters)));
+}
+
+using account = scl::synchronized_value<int, scl::async_mutex>;
+
+detached transfer (ex::static_thread_pool::scheduler_type sch, account& from, account& to, int n, std::latch& done)
+{
+    for ([[maybe_unused]] auto i : std::views::iota (0, n))
+    {
+        co_await async_apply (sch, [] (int& f, int& t) { --f; ++t; }, from, to);
+
+        [[maybe_unused]] const auto total = co_await async_apply (sch, [] (int f, int t) { return f + t; }, to, from);
+        assert(total == 0);
+    }
+
+    done.count_down();
+}
+
+void test_many_coroutines()
+{
+    constexpr int num_coroutines = 2'000, num_transfers = 10;
+    account a (0), b (0);
+    std::latch done (num_coroutines);
+
+    {
+        ex::static_thread_pool pool (4);
+
+        // Half move from a to b and half from b to a, locking in opposite orders
+        for (auto i : std::views::iota (0, num_coroutines))
+        {
+            if (i % 2 == 0)
+                transfer (pool.get_scheduler(), a, b, num_transfers, done);
+            else
+                transfer (pool.get_scheduler(), b, a, num_transfers, done);
+        }
+
+        done.wait();
+    }
+
+    [[maybe_unused]] const auto final_a = apply ([] (int v) { return v; }, a);
+    [[maybe_unused]] const auto final_b = apply ([] (int v) { return v; }, b);
+    assert(final_a == 0);
+    assert(final_b == 0);
+}
+
+detached append_stored (ex::run_loop& loop, scl::synchronized_value<std::vector<int>, scl::async_mutex>& order)
+{
+    // The awaiter outlives the full expression that created the lambda
+    auto aw = async_apply (loop.get_scheduler(),
+                           [extra = std::vector { 1, 2, 3 }] (std::vector<int>& o) { o.insert (o.end(), extra.begin(), extra.end()); },
+                           order);
+    co_await aw;
+    loop.finish();
+}
+
+void test_stored_awaiter()
+{
+    ex::run_loop loop;
+    scl::synchronized_value<std::vector<int>, scl::async_mutex> order;
+
+    append_stored (loop, order);
+    loop.run();
+
+    [[maybe_unused]] const auto result = apply ([] (auto& o) { return o; }, order);
+    assert(std::ranges::equal (result, std::vector { 1, 2, 3 }));
+}
+
+int main()
+{
+    test_fifo_handover();
+    test_many_coroutines();
+    test_stored_awaiter();
+
+    return 0;
+}
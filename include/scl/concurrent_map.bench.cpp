@@ -0,0 +1,85 @@
+#include <chrono>
+#include <print>
+#include <ranges>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "concurrent_map.h"
+#include "synchronized_value.h"
+
+// Compares lookups from many threads, with a few updates, between a
+// std::unordered_map behind a single lock and a concurrent_map
+
+constexpr int num_keys = 10'000;
+constexpr int ops_per_thread = 1'000'000;
+constexpr int update_every = 64;
+
+template<typename Fn>
+double time_ms (int num_threads, Fn&& fn)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    {
+        std::vector<std::jthread> threads;
+
+        for (auto t : std::views::iota (0, num_threads))
+            threads.emplace_back ([&fn, t] { fn (t); });
+    }
+
+    return std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+    scl::synchronized_value<std::unordered_map<int, int>> locked_map;
+    scl::concurrent_map<int, int> concurrent_map;
+
+    for (auto i : std::views::iota (0, num_keys))
+    {
+        apply ([i] (auto& m) { m[i] = i; }, locked_map);
+        concurrent_map.insert (i, i);
+    }
+
+    const auto max_threads = static_cast<int> (std::max (std::thread::hardware_concurrency(), 1u));
+    std::println ("{} ops per thread, 1 in {} an update", ops_per_thread, update_every);
+
+    for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2)
+    {
+        const auto locked = time_ms (num_threads, [&] (int t)
+        {
+            long long sum = 0;
+
+            for (auto i : std::views::iota (0, ops_per_thread))
+            {
+                const auto key = (i * 7 + t) % num_keys;
+
+                if (i % update_every == 0)
+                    apply ([&] (auto& m) { ++m[key]; }, locked_map);
+                else
+                    sum += apply ([&] (auto& m) { return m.find (key)->second; }, locked_map);
+            }
+
+            [[maybe_unused]] volatile auto result = sum;
+        });
+
+        const auto concurrent = time_ms (num_threads, [&] (int t)
+        {
+            long long sum = 0;
+
+            for (auto i : std::views::iota (0, ops_per_thread))
+            {
+                const auto key = (i * 7 + t) % num_keys;
+
+                if (i % update_every == 0)
+                    concurrent_map.apply_to (key, [] (int& v) { ++v; });
+                else
+                    sum += *concurrent_map.find (key);
+            }
+
+            [[maybe_unused]] volatile auto result = sum;
+        });
+
+        std::println ("{:3} threads  synchronized_value<unordered_map>: {:9.2f} ms   concurrent_map: {:9.2f} ms",
+                      num_threads, locked, concurrent);
+    }
+}
@@ -0,0 +1,329 @@
+#pragma once
+
+#include "sync_send.h"
+#include "utils/cache_line.h"
+#include "utils/reclamation.h"
+#include <atomic>
+#include <bit>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace scl {
+
+/**
+ *  A hash map that can be shared between threads without an external lock.
+ *
+ *  Keys are split between a number of stripes, each with its own lock and
+ *  bucket array, so writers only contend when their keys share a stripe.
+ *
+ *  Lookups (find, contains and visit) don't take any locks. Nodes are never
+ *  modified once they're visible to readers, instead writers link in a new
+ *  node and retire the old one to an epoch_domain so it is only deleted once
+ *  no reader can still be looking at it. A lookup is therefore a few atomic
+ *  loads and never blocks or is blocked by a writer.
+ *
+ *  apply_to is the way to update a value based on its current contents. It
+ *  holds the stripe lock while the function runs, so concurrent calls for
+ *  the same key never lose updates.
+ *
+ *  Keys and values must be send and copyable as buckets are rebuilt with
+ *  copies when a stripe grows.
+ *
+ *  @code
+ *  scl::concurrent_map<std::string, int> counts;
+ *  counts.insert ("a", 0);
+ *  counts.apply_to ("a", [] (int& c) { ++c; });    // From any thread
+ *  auto a = counts.find ("a");                     // std::optional<int>
+ *  @endcode
+ */
+template<send Key, send T, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+class concurrent_map
+{
+public:
+    /** Creates a map with num_stripes locks (rounded up to a power of two). */
+    explicit concurrent_map (std::size_t num_stripes = 64)
+        : stripes (std::make_unique<stripe[]> (std::bit_ceil (std::max<std::size_t> (num_stripes, 1)))),
+          stripe_mask (std::bit_ceil (std::max<std::size_t> (num_stripes, 1)) - 1),
+          stripe_bits (std::popcount (stripe_mask))
+    {
+        for (std::size_t i = 0; i <= stripe_mask; ++i)
+            stripes[i].buckets.store (new bucket_array (initial_buckets, stripe_bits), std::memory_order_relaxed);
+    }
+
+    concurrent_map (const concurrent_map&) = delete;
+    concurrent_map& operator= (const concurrent_map&) = delete;
+
+    ~concurrent_map()
+    {
+        for (std::size_t i = 0; i <= stripe_mask; ++i)
+            delete stripes[i].buckets.load (std::memory_order_acquire);
+    }
+
+    //==========================================
+    /** Returns a copy of the value for key, if there is one. Lock-free. */
+    std::optional<T> find (const Key& key) const
+    {
+        std::optional<T> result;
+        visit (key, [&] (const T& value) { result.emplace (value); });
+        return result;
+    }
+
+    /** Returns true if the map has a value for key. Lock-free. */
+    bool contains (const Key& key) const
+    {
+        return visit (key, [] (const T&) {});
+    }
+
+    /** Calls f with a const reference to the value for key, if there is one,
+        and returns true if it was called. Lock-free.
+        The value may be replaced during the call but remains valid until f
+        returns so f should be short and must not keep a reference to it.
+    */
+    template<typename F>
+    bool visit (const Key& key, F&& f) const
+    {
+        const auto hash = hasher (key);
+        auto& s = stripe_for (hash);
+        auto guard = domain.pin();
+
+        // acquire: see the contents of nodes linked in by writers
+        auto b = s.buckets.load (std::memory_order_acquire);
+
+        for (auto n = b->bucket_for (hash).load (std::memory_order_acquire); n; n = n->next.load (std::memory_order_acquire))
+        {
+            if (n->hash == hash && key_equal (n->key, key))
+            {
+                std::invoke (std::forward<F> (f), std::as_const (n->value));
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    //==========================================
+    /** Adds value for key if there isn't already one, returning true if it was added. */
+    bool insert (const Key& key, T value)
+    {
+        const auto hash = hasher (key);
+        auto& s = stripe_for (hash);
+        std::scoped_lock _ (s.mutex);
+
+        if (find_locked (s, key, hash).found)
+            return false;
+
+        add_locked (s, new node { hash, key, std::move (value) });
+        return true;
+    }
+
+    /** Sets the value for key, adding it if needed. */
+    void insert_or_assign (const Key& key, T value)
+    {
+        const auto hash = hasher (key);
+        auto& s = stripe_for (hash);
+        std::scoped_lock _ (s.mutex);
+
+        if (auto position = find_locked (s, key, hash); position.found)
+            replace_locked (position, std::move (value));
+        else
+            add_locked (s, new node { hash, key, std::move (value) });
+    }
+
+    /** Updates the value for key by calling f with a reference to a copy of
+        it, then publishing the copy. Returns false if there is no value.
+        Holds the stripe lock during the call so updates to the same key are
+        never lost.
+    */
+    template<typename F>
+    bool apply_to (const Key& key, F&& f)
+    {
+        const auto hash = hasher (key);
+        auto& s = stripe_for (hash);
+        std::scoped_lock _ (s.mutex);
+
+        auto position = find_locked (s, key, hash);
+
+        if (! position.found)
+            return false;
+
+        T value (position.found->value);
+        std::invoke (std::forward<F> (f), value);
+        replace_locked (position, std::move (value));
+        return true;
+    }
+
+    /** Removes the value for key, returning true if there was one. */
+    bool erase (const Key& key)
+    {
+        const auto hash = hasher (key);
+        auto& s = stripe_for (hash);
+        std::scoped_lock _ (s.mutex);
+
+        auto position = find_locked (s, key, hash);
+
+        if (! position.found)
+            return false;
+
+        // release: readers following the link see a complete node
+        position.link->store (position.found->next.load (std::memory_order_relaxed), std::memory_order_release);
+        s.size.store (s.size.load (std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        domain.retire (position.found);
+        return true;
+    }
+
+    /** Returns the number of values.
+        This is only exact if no other threads are modifying the map.
+    */
+    std::size_t size() const
+    {
+        std::size_t num = 0;
+
+        for (std::size_t i = 0; i <= stripe_mask; ++i)
+            num += stripes[i].size.load (std::memory_order_relaxed);
+
+        return num;
+    }
+
+    std::size_t num_stripes() const
+    {
+        return stripe_mask + 1;
+    }
+
+private:
+    //==========================================
+    struct node
+    {
+        const std::size_t hash;
+        const Key key;
+        const T value;
+        std::atomic<node*> next { nullptr };
+    };
+
+    struct bucket_array
+    {
+        bucket_array (std::size_t num_buckets, int hash_shift)
+            : mask (num_buckets - 1),
+              shift (hash_shift),
+              buckets (std::make_unique<std::atomic<node*>[]> (num_buckets))
+        {}
+
+        /** Deletes the nodes, only called once the array is no longer shared. */
+        ~bucket_array()
+        {
+            for (std::size_t i = 0; i <= mask; ++i)
+                for (auto n = buckets[i].load (std::memory_order_relaxed); n;)
+                    delete std::exchange (n, n->next.load (std::memory_order_relaxed));
+        }
+
+        std::atomic<node*>& bucket_for (std::size_t hash) const
+        {
+            // The low bits have already been used to pick the stripe
+            return buckets[(hash >> shift) & mask];
+        }
+
+        const std::size_t mask;
+        const int shift;
+        std::unique_ptr<std::atomic<node*>[]> buckets;
+    };
+
+    struct alignas (cache_line_size) stripe
+    {
+        std::mutex mutex;
+        std::atomic<bucket_array*> buckets { nullptr };
+        std::atomic<std::size_t> size { 0 };    // Only written with mutex held
+    };
+
+    /** Where a node is linked from, so it can be unlinked or replaced. */
+    struct position
+    {
+        std::atomic<node*>* link = nullptr;
+        node* found = nullptr;
+    };
+
+    static constexpr std::size_t initial_buckets = 8;
+
+    [[no_unique_address]] Hash hasher;
+    [[no_unique_address]] KeyEqual key_equal;
+    std::unique_ptr<stripe[]> stripes;
+    const std::size_t stripe_mask;
+    const int stripe_bits;
+    mutable epoch_domain domain;
+
+    stripe& stripe_for (std::size_t hash) const
+    {
+        return stripes[hash & stripe_mask];
+    }
+
+    position find_locked (stripe& s, const Key& key, std::size_t hash)
+    {
+        auto link = &s.buckets.load (std::memory_order_relaxed)->bucket_for (hash);
+
+        for (auto n = link->load (std::memory_order_relaxed); n; n = n->next.load (std::memory_order_relaxed))
+        {
+            if (n->hash == hash && key_equal (n->key, key))
+                return { link, n };
+
+            link = &n->next;
+        }
+
+        return {};
+    }
+
+    void add_locked (stripe& s, node* n)
+    {
+        auto b = s.buckets.load (std::memory_order_relaxed);
+        auto& bucket = b->bucket_for (n->hash);
+        n->next.store (bucket.load (std::memory_order_relaxed), std::memory_order_relaxed);
+
+        // release: publish the node's contents to readers
+        bucket.store (n, std::memory_order_release);
+
+        const auto size = s.size.load (std::memory_order_relaxed) + 1;
+        s.size.store (size, std::memory_order_relaxed);
+
+        if (size > b->mask + 1)
+            grow_locked (s, *b);
+    }
+
+    void replace_locked (position p, T value)
+    {
+        auto n = new node { p.found->hash, p.found->key, std::move (value) };
+        n->next.store (p.found->next.load (std::memory_order_relaxed), std::memory_order_relaxed);
+
+        // release: publish the node's contents to readers
+        p.link->store (n, std::memory_order_release);
+        domain.retire (p.found);
+    }
+
+    /** Readers may be traversing the current buckets so they can't be
+        relinked. Instead the nodes are copied in to a new array twice the
+        size and the old array and its nodes retired.
+    */
+    void grow_locked (stripe& s, bucket_array& old_buckets)
+    {
+        auto new_buckets = new bucket_array ((old_buckets.mask + 1) * 2, stripe_bits);
+
+        for (std::size_t i = 0; i <= old_buckets.mask; ++i)
+        {
+            for (auto n = old_buckets.buckets[i].load (std::memory_order_relaxed); n; n = n->next.load (std::memory_order_relaxed))
+            {
+                auto& bucket = new_buckets->bucket_for (n->hash);
+                auto copy = new node { n->hash, n->key, n->value };
+                copy->next.store (bucket.load (std::memory_order_relaxed), std::memory_order_relaxed);
+                bucket.store (copy, std::memory_order_relaxed);
+            }
+        }
+
+        // release: publish the new array and its nodes to readers
+        s.buckets.store (new_buckets, std::memory_order_release);
+        domain.retire (&old_buckets);
+    }
+};
+
+template<typename Key, typename T, typename Hash, typename KeyEqual>
+struct is_sync<concurrent_map<Key, T, Hash, KeyEqual>> : std::true_type {};
+
+}
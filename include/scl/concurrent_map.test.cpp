@@ -0,0 +1,127 @@
+#include <cassert>
+#include <ranges>
+#include <string>
+#include "concurrent_map.h"
+#include "task_scope.h"
+
+using string_map = scl::concurrent_map<std::string, std::string>;
+
+static_assert(scl::is_sync_v<string_map>);
+static_assert(scl::sync_reference<string_map&>);
+
+void test_single_thread()
+{
+    string_map map (4);
+    assert(map.num_stripes() == 4);
+    assert(! map.contains ("a"));
+    assert(! map.find ("a"));
+
+    [[maybe_unused]] auto inserted = map.insert ("a", "1");
+    assert(inserted);
+    inserted = map.insert ("a", "2");
+    assert(! inserted);
+    assert(map.find ("a") == "1");
+
+    map.insert_or_assign ("a", "2");
+    map.insert_or_assign ("b", "3");
+    assert(map.find ("a") == "2");
+    assert(map.find ("b") == "3");
+    assert(map.size() == 2);
+
+    [[maybe_unused]] auto applied = map.apply_to ("a", [] (std::string& s) { s += "2"; });
+    assert(applied);
+    applied = map.apply_to ("c", [] (std::string& s) { s += "2"; });
+    assert(! applied);
+    assert(map.find ("a") == "22");
+
+    [[maybe_unused]] std::size_t length = 0;
+    assert(map.visit ("a", [&] (const std::string& s) { length = s.size(); }));
+    assert(length == 2);
+
+    [[maybe_unused]] auto erased = map.erase ("a");
+    assert(erased);
+    erased = map.erase ("a");
+    assert(! erased);
+    assert(! map.contains ("a"));
+    assert(map.size() == 1);
+
+    // Grow every stripe several times
+    for (auto i : std::views::iota (0, 1'000))
+        map.insert (std::to_string (i), std::to_string (i * 2));
+
+    assert(map.size() == 1'001);
+
+    for ([[maybe_unused]] auto i : std::views::iota (0, 1'000))
+        assert(map.find (std::to_string (i)) == std::to_string (i * 2));
+}
+
+void increment (scl::concurrent_map<int, int>& map, int num_keys, int n)
+{
+    for (auto i : std::views::iota (0, n))
+        map.apply_to (i % num_keys, [] (int& v) { ++v; });
+}
+
+void find_values (const scl::concurrent_map<int, int>& map, int num_keys, int n)
+{
+    for (auto i : std::views::iota (0, n))
+    {
+        // Keys are never erased so always found and values only increase
+        [[maybe_unused]] const auto v = map.find (i % num_keys);
+        assert(v && *v >= 0);
+    }
+}
+
+void insert_and_erase (scl::concurrent_map<int, int>& map, int first_key, int n)
+{
+    for (auto i : std::views::iota (first_key, first_key + n))
+    {
+        [[maybe_unused]] const auto inserted = map.insert (i, i);
+        assert(inserted);
+    }
+
+    for (auto i : std::views::iota (first_key, first_key + n))
+        if (i % 2 == 0)
+            map.erase (i);
+}
+
+void test_concurrent_updates()
+{
+    constexpr int num_keys = 16, num_increments = 20'000;
+    scl::concurrent_map<int, int> map (4);
+
+    for (auto i : std::views::iota (0, num_keys))
+        map.insert (i, 0);
+
+    {
+        scl::task_scope scope;
+
+        for ([[maybe_unused]] auto i : std::views::iota (0, 4))
+            scope.spawn (increment, map, auto (num_keys), auto (num_increments));
+
+        for ([[maybe_unused]] auto i : std::views::iota (0, 4))
+            scope.spawn (find_values, map, auto (num_keys), auto (num_increments));
+
+        for (auto i : std::views::iota (1, 5))
+            scope.spawn (insert_and_erase, map, i * 10'000, 5'000);
+    }
+
+    // No increments are lost
+    int total = 0;
+
+    for (auto i : std::views::iota (0, num_keys))
+        total += *map.find (i);
+
+    assert(total == 4 * num_increments);
+
+    // Half of the inserted keys were erased
+    assert(map.size() == num_keys + 4 * 2'500);
+    assert(map.contains (10'001) && ! map.contains (10'000));
+}
+
+int main()
+{
+    test_single_thread();
+    test_concurrent_updates();
+
+    return 0;
+}
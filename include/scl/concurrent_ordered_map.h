@@ -0,0 +1,509 @@
+#pragma once
+
+#include "sync_send.h"
+#include "utils/reclamation.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <optional>
+#include <thread>
+#include <utility>
+
+namespace scl {
+
+/**
+ *  An ordered map that can be read and iterated from any number of threads
+ *  while other threads insert and erase.
+ *
+ *  This is a "lazy" skip list. Readers never take a lock or write to shared
+ *  memory: lookups and iteration just follow atomic links. Writers lock only
+ *  the few nodes either side of the one being added or removed, so writers
+ *  to different parts of the map don't contend. Removed nodes are retired to
+ *  an epoch_domain so a reader can keep following a node that has just been
+ *  removed.
+ *
+ *  Iterating a range visits keys in strictly increasing order. Every key
+ *  present for the whole iteration is visited and any other key visited was
+ *  present at some point during it.
+ *
+ *  Values are immutable once inserted. To change one, erase it and insert
+ *  the new value.
+ *
+ *  @code
+ *  scl::concurrent_ordered_map<int, order> book;
+ *  book.insert (price, o);                         // From any thread
+ *  for (auto& [price, o] : book.range (100, 110))  // Concurrently
+ *      ...
+ *  @endcode
+ */
+template<send Key, send T, typename Compare = std::less<Key>>
+class concurrent_ordered_map
+{
+    struct node;
+
+public:
+    using value_type = std::pair<const Key, T>;
+
+    //==========================================
+    /** A range of entries that keeps the nodes alive while it exists.
+        Iterators must not be used after the range has been destroyed.
+    */
+    class scoped_range
+    {
+    public:
+        class iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = concurrent_ordered_map::value_type;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const value_type*;
+            using reference = const value_type&;
+
+            iterator() = default;
+
+            reference operator*() const     { return n->entry(); }
+            pointer operator->() const      { return &n->entry(); }
+
+            iterator& operator++()
+            {
+                n = r->next_in_range (n->next()[0].load (std::memory_order_acquire));
+                return *this;
+            }
+
+            iterator operator++ (int)
+            {
+                auto copy = *this;
+                ++*this;
+                return copy;
+            }
+
+            bool operator== (const iterator& other) const { return n == other.n; }
+
+        private:
+            friend scoped_range;
+
+            iterator (const scoped_range& range_to_use, node* node_to_use)
+                : r (&range_to_use), n (node_to_use)
+            {}
+
+            const scoped_range* r = nullptr;
+            node* n = nullptr;
+        };
+
+        scoped_range (const scoped_range&) = delete;
+        scoped_range& operator= (const scoped_range&) = delete;
+
+        iterator begin() const  { return { *this, first }; }
+        iterator end() const    { return { *this, nullptr }; }
+
+    private:
+        friend concurrent_ordered_map;
+
+        scoped_range (const concurrent_ordered_map& map_to_use, epoch_domain::guard guard_to_use,
+                      std::optional<Key> from_key, std::optional<Key> to_key)
+            : map (map_to_use),
+              guard (std::move (guard_to_use)),
+              to (std::move (to_key)),
+              first (next_in_range (from_key ? map.lower_bound (*from_key) : map.head->next()[0].load (std::memory_order_acquire)))
+        {}
+
+        const concurrent_ordered_map& map;
+        epoch_domain::guard guard;
+        const std::optional<Key> to;
+        node* const first;
+
+        node* next_in_range (node* n) const
+        {
+            // Skip nodes that are being inserted or have been removed
+            while (n && (n->marked.load (std::memory_order_acquire) || ! n->fully_linked.load (std::memory_order_acquire)))
+                n = n->next()[0].load (std::memory_order_acquire);
+
+            if (n && to && ! map.compare (n->entry().first, *to))
+                return nullptr;
+
+            return n;
+        }
+    };
+
+    //==========================================
+    concurrent_ordered_map()
+        : head (create_node (max_height))
+    {}
+
+    concurrent_ordered_map (const concurrent_ordered_map&) = delete;
+    concurrent_ordered_map& operator= (const concurrent_ordered_map&) = delete;
+
+    ~concurrent_ordered_map()
+    {
+        for (auto n = head->next()[0].load (std::memory_order_acquire); n;)
+            destroy_node (std::exchange (n, n->next()[0].load (std::memory_order_relaxed)));
+
+        destroy_head (head);
+    }
+
+    //==========================================
+    /** Returns a copy of the value for key, if there is one. Lock-free. */
+    std::optional<T> find (const Key& key) const
+    {
+        std::optional<T> result;
+        visit (key, [&] (const T& value) { result.emplace (value); });
+        return result;
+    }
+
+    /** Returns true if the map has a value for key. Lock-free. */
+    bool contains (const Key& key) const
+    {
+        return visit (key, [] (const T&) {});
+    }
+
+    /** Calls f with a const reference to the value for key, if there is one,
+        and returns true if it was called. Lock-free.
+    */
+    template<typename F>
+    bool visit (const Key& key, F&& f) const
+    {
+        auto guard = domain.pin();
+        auto n = lower_bound (key);
+
+        if (! n || compare (key, n->entry().first)
+            || n->marked.load (std::memory_order_acquire)
+            || ! n->fully_linked.load (std::memory_order_acquire))
+            return false;
+
+        std::invoke (std::forward<F> (f), std::as_const (n->entry().second));
+        return true;
+    }
+
+    /** Returns the entries with keys in [from, to). */
+    scoped_range range (const Key& from, const Key& to) const
+    {
+        return { *this, domain.pin(), from, to };
+    }
+
+    /** Returns all the entries. */
+    scoped_range range() const
+    {
+        return { *this, domain.pin(), std::nullopt, std::nullopt };
+    }
+
+    //==========================================
+    /** Adds value for key if there isn't already one, returning true if it was added. */
+    bool insert (Key key, T value)
+    {
+        const auto height = random_height();
+        node* preds[max_height];
+        node* succs[max_height];
+        auto guard = domain.pin();
+
+        for (;;)
+        {
+            if (const auto level = find (key, preds, succs); level != -1)
+            {
+                const auto found = succs[level];
+
+                // If it's being removed wait for that to finish and try again
+                if (found->marked.load (std::memory_order_acquire))
+                    continue;
+
+                while (! found->fully_linked.load (std::memory_order_acquire))
+                    std::this_thread::yield();
+
+                return false;
+            }
+
+            locked_nodes locks;
+            bool valid = true;
+
+            for (int level = 0; valid && level < height; ++level)
+            {
+                const auto pred = preds[level], succ = succs[level];
+                locks.lock (pred);
+
+                valid = ! pred->marked.load (std::memory_order_acquire)
+                     && (! succ || ! succ->marked.load (std::memory_order_acquire))
+                     && pred->next()[level].load (std::memory_order_relaxed) == succ;
+            }
+
+            if (! valid)
+                continue;
+
+            auto n = create_node (height, std::move (key), std::move (value));
+
+            for (int level = 0; level < height; ++level)
+                n->next()[level].store (succs[level], std::memory_order_relaxed);
+
+            // release: publish the node's contents to readers
+            for (int level = 0; level < height; ++level)
+                preds[level]->next()[level].store (n, std::memory_order_release);
+
+            n->fully_linked.store (true, std::memory_order_release);
+            num_entries.fetch_add (1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    /** Removes the value for key, returning true if there was one. */
+    bool erase (const Key& key)
+    {
+        node* preds[max_height];
+        node* succs[max_height];
+        node* victim = nullptr;
+        auto guard = domain.pin();
+
+        for (;;)
+        {
+            const auto level = find (key, preds, succs);
+
+            if (! victim)
+            {
+                if (level == -1)
+                    return false;
+
+                const auto candidate = succs[level];
+
+                // Only remove nodes that have finished being inserted
+                if (! candidate->fully_linked.load (std::memory_order_acquire)
+                    || candidate->height - 1 != level
+                    || candidate->marked.load (std::memory_order_acquire))
+                    return false;
+
+                candidate->lock();
+
+                if (candidate->marked.load (std::memory_order_relaxed))
+                {
+                    candidate->unlock();
+                    return false;
+                }
+
+                // Logically removed, readers will now skip it
+                candidate->marked.store (true, std::memory_order_release);
+                victim = candidate;
+            }
+
+            locked_nodes locks;
+            bool valid = true;
+
+            for (int l = 0; valid && l < victim->height; ++l)
+            {
+                const auto pred = preds[l];
+                locks.lock (pred);
+
+                valid = ! pred->marked.load (std::memory_order_acquire)
+                     && pred->next()[l].load (std::memory_order_relaxed) == victim;
+            }
+
+            if (! valid)
+                continue;
+
+            // The victim's links are left intact so readers on it can carry on
+            for (int l = victim->height - 1; l >= 0; --l)
+                preds[l]->next()[l].store (victim->next()[l].load (std::memory_order_relaxed), std::memory_order_release);
+
+            victim->unlock();
+            num_entries.fetch_sub (1, std::memory_order_relaxed);
+            domain.retire (victim, &destroy_node);
+            return true;
+        }
+    }
+
+    /** Returns the number of entries.
+        This is only exact if no other threads are modifying the map.
+    */
+    std::size_t size() const
+    {
+        return num_entries.load (std::memory_order_relaxed);
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+private:
+    //==========================================
+    static constexpr int max_height = 24;
+
+    struct alignas (std::atomic<node*>) node
+    {
+        explicit node (int height_to_use)
+            : height (height_to_use)
+        {}
+
+        /** The links for each level are allocated after the node. */
+        std::atomic<node*>* next() noexcept
+        {
+            return std::launder (reinterpret_cast<std::atomic<node*>*> (this + 1));
+        }
+
+        const value_type& entry() const noexcept
+        {
+            return *std::launder (reinterpret_cast<const value_type*> (storage));
+        }
+
+        void lock() noexcept
+        {
+            while (locked.exchange (true, std::memory_order_acquire))
+                locked.wait (true, std::memory_order_relaxed);
+        }
+
+        void unlock() noexcept
+        {
+            locked.store (false, std::memory_order_release);
+            locked.notify_one();
+        }
+
+        const int height;
+        std::atomic<bool> marked { false }, fully_linked { false }, locked { false };
+        alignas (value_type) std::byte storage[sizeof (value_type)];
+    };
+
+    /** Locks nodes in order, skipping repeats, and unlocks them all when destroyed. */
+    struct locked_nodes
+    {
+        ~locked_nodes()
+        {
+            for (int i = 0; i < num; ++i)
+                nodes[i]->unlock();
+        }
+
+        void lock (node* n)
+        {
+            if (num > 0 && nodes[num - 1] == n)
+                return;
+
+            n->lock();
+            nodes[num++] = n;
+        }
+
+        node* nodes[max_height];
+        int num = 0;
+    };
+
+    [[no_unique_address]] Compare compare;
+    node* const head;
+    std::atomic<std::size_t> num_entries { 0 };
+    mutable epoch_domain domain;
+
+    //==========================================
+    static void* allocate_node (int height)
+    {
+        auto memory = ::operator new (sizeof (node) + height * sizeof (std::atomic<node*>), std::align_val_t (alignof (node)));
+        auto n = ::new (memory) node (height);
+
+        for (int i = 0; i < height; ++i)
+            ::new (static_cast<void*> (reinterpret_cast<std::atomic<node*>*> (n + 1) + i)) std::atomic<node*> (nullptr);
+
+        return n;
+    }
+
+    static void deallocate_node (node* n)
+    {
+        n->~node();
+        ::operator delete (static_cast<void*> (n), std::align_val_t (alignof (node)));
+    }
+
+    template<typename... Args>
+    static node* create_node (int height, Args&&... args)
+    {
+        auto n = static_cast<node*> (allocate_node (height));
+
+        if constexpr (sizeof... (Args) > 0)
+        {
+            try
+            {
+                ::new (static_cast<void*> (n->storage)) value_type (std::forward<Args> (args)...);
+            }
+            catch (...)
+            {
+                deallocate_node (n);
+                throw;
+            }
+        }
+
+        return n;
+    }
+
+    static void destroy_node (void* p)
+    {
+        auto n = static_cast<node*> (p);
+        n->entry().~value_type();
+        deallocate_node (n);
+    }
+
+    /** The head has no entry, only links. */
+    static void destroy_head (node* n)
+    {
+        deallocate_node (n);
+    }
+
+    static int random_height()
+    {
+        thread_local std::uint64_t state = std::bit_cast<std::uintptr_t> (&state) | 1;
+
+        // xorshift64, each level is a quarter as likely as the one below
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        return std::min (1 + std::countr_zero (state) / 2, max_height);
+    }
+
+    /** Fills in the last node before key and the one after it on each level,
+        returning the highest level key was found on or -1.
+    */
+    int find (const Key& key, node** preds, node** succs) const
+    {
+        int found_level = -1;
+        auto pred = head;
+
+        for (int level = max_height - 1; level >= 0; --level)
+        {
+            auto curr = pred->next()[level].load (std::memory_order_acquire);
+
+            while (curr && compare (curr->entry().first, key))
+            {
+                pred = curr;
+                curr = pred->next()[level].load (std::memory_order_acquire);
+            }
+
+            if (found_level == -1 && curr && ! compare (key, curr->entry().first))
+                found_level = level;
+
+            preds[level] = pred;
+            succs[level] = curr;
+        }
+
+        return found_level;
+    }
+
+    /** Returns the first node on the bottom level not less than key. */
+    node* lower_bound (const Key& key) const
+    {
+        auto pred = head;
+        node* curr = nullptr;
+
+        for (int level = max_height - 1; level >= 0; --level)
+        {
+            curr = pred->next()[level].load (std::memory_order_acquire);
+
+            while (curr && compare (curr->entry().first, key))
+            {
+                pred = curr;
+                curr = pred->next()[level].load (std::memory_order_acquire);
+            }
+        }
+
+        return curr;
+    }
+};
+
+template<typename Key, typename T, typename Compare>
+struct is_sync<concurrent_ordered_map<Key, T, Compare>> : std::true_type {};
+
+}
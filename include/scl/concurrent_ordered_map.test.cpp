@@ -0,0 +1,143 @@
+#include <cassert>
+#include <functional>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <vector>
+#include "concurrent_ordered_map.h"
+#include "task_scope.h"
+
+using string_map = scl::concurrent_ordered_map<int, std::string>;
+
+static_assert(scl::is_sync_v<string_map>);
+static_assert(scl::sync_reference<string_map&>);
+static_assert(std::forward_iterator<string_map::scoped_range::iterator>);
+
+void test_single_thread()
+{
+    string_map map;
+    assert(map.empty());
+    assert(! map.contains (1));
+
+    for (auto i : { 5, 1, 9, 3, 7 })
+        map.insert (i, std::to_string (i));
+
+    [[maybe_unused]] auto inserted = map.insert (3, "three");
+    assert(! inserted);
+    assert(map.find (3) == "3");
+    assert(map.size() == 5);
+
+    std::vector<int> keys;
+
+    for (auto& [key, value] : map.range())
+    {
+        assert(value == std::to_string (key));
+        keys.push_back (key);
+    }
+
+    assert((keys == std::vector { 1, 3, 5, 7, 9 }));
+
+    keys.clear();
+
+    for (auto& entry : map.range (3, 9))
+        keys.push_back (entry.first);
+
+    assert((keys == std::vector { 3, 5, 7 }));
+
+    [[maybe_unused]] auto erased = map.erase (5);
+    assert(erased);
+    erased = map.erase (5);
+    assert(! erased);
+    assert(! map.contains (5));
+    assert(map.size() == 4);
+
+    auto range = map.range (2, 8);
+    assert(std::ranges::distance (range.begin(), range.end()) == 2);
+}
+
+void test_reverse_order()
+{
+    scl::concurrent_ordered_map<int, int, std::greater<int>> map;
+
+    for (auto i : std::views::iota (0, 100))
+        map.insert (i, i);
+
+    [[maybe_unused]] int expected = 99;
+
+    for ([[maybe_unused]] auto& [key, value] : map.range())
+        assert(key == expected--);
+
+    assert(expected == -1);
+}
+
+void insert_and_erase (scl::concurrent_ordered_map<int, int>& map, int thread_index, int num_threads, int n)
+{
+    // Each thread inserts every num_threads'th key so they interleave
+    for (auto i : std::views::iota (0, n))
+    {
+        [[maybe_unused]] const auto inserted = map.insert (i * num_threads + thread_index, i);
+        assert(inserted);
+    }
+
+    for (auto i : std::views::iota (0, n))
+        if (i % 2 == 0)
+            map.erase (i * num_threads + thread_index);
+}
+
+void iterate (const scl::concurrent_ordered_map<int, int>& map, int num_passes)
+{
+    for ([[maybe_unused]] auto pass : std::views::iota (0, num_passes))
+    {
+        [[maybe_unused]] std::optional<int> previous;
+        auto range = map.range();
+
+        // The first key is never erased so is always visited
+        assert(range.begin()->first == -1);
+
+        for ([[maybe_unused]] auto& [key, value] : range)
+        {
+            // Always strictly increasing, however the map changes
+            assert(! previous || key > *previous);
+            previous = key;
+        }
+    }
+}
+
+void test_concurrent_range_iteration()
+{
+    constexpr int num_writers = 4, num_keys = 5'000;
+    scl::concurrent_ordered_map<int, int> map;
+
+    // Present for the whole test so must always be visited
+    map.insert (-1, 0);
+
+    {
+        scl::task_scope scope;
+
+        for (auto i : std::views::iota (0, num_writers))
+            scope.spawn (insert_and_erase, map, auto (i), auto (num_writers), auto (num_keys));
+
+        for ([[maybe_unused]] auto i : std::views::iota (0, 2))
+            scope.spawn (iterate, map, 20);
+    }
+
+    assert(map.size() == 1 + num_writers * num_keys / 2);
+
+    std::vector<int> keys;
+
+    for (auto& entry : map.range (0, num_writers * num_keys))
+        keys.push_back (entry.first);
+
+    assert(keys.size() == num_writers * num_keys / 2);
+    assert(std::ranges::all_of (keys, [] (auto k) { return (k / num_writers) % 2 == 1; }));
+    assert(std::ranges::is_sorted (keys));
+}
+
+int main()
+{
+    test_single_thread();
+    test_reverse_order();
+    test_concurrent_range_iteration();
+
+    return 0;
+}
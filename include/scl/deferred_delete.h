@@ -0,0 +1,278 @@
+#pragma once
+
+#include "send_function.h"
+#include "utils/cache_line.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace scl {
+
+namespace detail {
+/** Holds an object in a send_function so that destroying the function
+    destroys the object.
+*/
+template<typename T>
+struct deferred_object
+{
+    void operator()() {}
+    T object;
+};
+}
+
+template<typename T>
+    requires send<T>
+struct is_send<detail::deferred_object<T>> : std::true_type {};
+
+/**
+ *  Hands objects off to a background thread to be destroyed.
+ *
+ *  Destroying an object can mean running an arbitrary destructor and freeing
+ *  memory, both of which can block. On a realtime thread (e.g. an audio
+ *  thread dropping the last reference to some state) these can cause
+ *  glitches so this moves the object to a bounded queue and a background
+ *  thread destroys it later, along with everything else queued, in batches.
+ *
+ *  defer() never allocates or blocks. It is wait-free when only a single thread
+ *  defers objects and lock-free otherwise. The background thread sleeps on an
+ *  atomic wait while the queue is empty and advertises when it does so only
+ *  the first defer() after it goes idle makes a system call to wake it, the
+ *  rest just check a flag.
+ *
+ *  Objects must be send as they're destroyed on another thread and are stored
+ *  inline so must be no bigger than ObjectCapacity bytes. Typically you'd
+ *  defer a std::unique_ptr, arc, std::vector etc.
+ *
+ *  @code
+ *  scl::deferred_delete reclaimer;
+ *  reclaimer.defer (std::move (old_state)); // On the audio thread
+ *  @endcode
+ */
+template<std::size_t ObjectCapacity = 64>
+class deferred_delete
+{
+public:
+    struct statistics
+    {
+        std::size_t deferred = 0;       // Objects successfully queued
+        std::size_t deleted = 0;        // Objects destroyed by the background thread
+        std::size_t rejected = 0;       // Objects not queued because the queue was full
+        std::size_t batches = 0;        // Number of times the background thread ran with a non-empty queue
+        std::size_t backlog = 0;        // Objects currently waiting to be destroyed
+        std::size_t max_backlog = 0;    // Largest backlog the background thread has seen
+    };
+
+    /** Creates a queue that can hold capacity objects (rounded up to a power of
+        two). The background thread wakes as soon as an object is deferred and
+        then waits for interval, if non-zero, to destroy more in the same batch.
+    */
+    explicit deferred_delete (std::size_t capacity = 1024,
+                              std::chrono::milliseconds interval_to_use = std::chrono::milliseconds (0))
+        : slots (std::bit_ceil (std::max<std::size_t> (capacity, 2))),
+          mask (slots.size() - 1),
+          interval (interval_to_use)
+    {
+        for (std::size_t i = 0; i < slots.size(); ++i)
+            slots[i].sequence.store (i, std::memory_order_relaxed);
+
+        thread = std::thread ([this] { run(); });
+    }
+
+    /** Stops the background thread, destroying anything still queued. */
+    ~deferred_delete()
+    {
+        {
+            std::scoped_lock _ (mutex);
+            should_exit = true;
+        }
+
+        condition.notify_one();
+        sleeping.store (false);
+        sleeping.notify_one();
+        thread.join();
+        collect();
+    }
+
+    /** Moves object in to the queue to be destroyed on the background thread.
+        If the queue is full, returns false and object is left untouched.
+    */
+    template<typename T>
+    bool defer (T&& object)
+    {
+        // N.B. We can't constrain T to the concept due to recursion of is_move_constructable
+        // So we have to statically assert it
+        static_assert (send<T>);
+        static_assert (! std::is_lvalue_reference_v<T>, "Ownership must be moved in to the queue");
+
+        auto pos = tail.load (std::memory_order_relaxed);
+
+        for (;;)
+        {
+            auto& s = slots[pos & mask];
+            const auto seq = s.sequence.load (std::memory_order_acquire);
+
+            if (seq == pos)
+            {
+                if (tail.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed))
+                {
+                    s.object = detail::deferred_object<std::remove_cvref_t<T>> { std::move (object) };
+                    // seq_cst: publish the object to the background thread and
+                    // order it before checking whether that's asleep, see run()
+                    s.sequence.store (pos + 1);
+
+                    if (sleeping.load() && sleeping.exchange (false))
+                        sleeping.notify_one();
+
+                    return true;
+                }
+            }
+            else if (seq < pos)
+            {
+                num_rejected.fetch_add (1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+            {
+                pos = tail.load (std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /** Blocks until everything deferred so far has been destroyed. */
+    void flush()
+    {
+        const auto target = tail.load (std::memory_order_acquire);
+        std::unique_lock lock (mutex);
+        flush_requested = true;
+        condition.notify_all();
+        condition.wait (lock, [&] { return head.load (std::memory_order_acquire) >= target; });
+    }
+
+    statistics stats() const
+    {
+        statistics s;
+        s.deleted       = head.load (std::memory_order_relaxed);
+        s.deferred      = std::max (tail.load (std::memory_order_relaxed), s.deleted);
+        s.rejected      = num_rejected.load (std::memory_order_relaxed);
+        s.batches       = num_batches.load (std::memory_order_relaxed);
+        s.backlog       = s.deferred - s.deleted;
+        s.max_backlog   = max_backlog.load (std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    struct alignas (cache_line_size) slot
+    {
+        std::atomic<std::size_t> sequence { 0 };
+        send_function<void(), ObjectCapacity> object;
+    };
+
+    std::vector<slot> slots;
+    const std::size_t mask;
+    const std::chrono::milliseconds interval;
+
+    alignas (cache_line_size) std::atomic<std::size_t> tail { 0 };
+    std::atomic<std::size_t> num_rejected { 0 };
+    std::atomic<bool> sleeping { false };
+
+    // Only written by the background thread
+    alignas (cache_line_size) std::atomic<std::size_t> head { 0 };
+    std::atomic<std::size_t> num_batches { 0 }, max_backlog { 0 };
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool should_exit = false, flush_requested = false;
+    std::thread thread;
+
+    void run()
+    {
+        for (;;)
+        {
+            // Advertise that we're going to sleep before checking for work so
+            // either defer() sees the flag and wakes us or we see its object.
+            // The destructor clears the flag after setting should_exit so we
+            // can't miss that either.
+            sleeping.store (true);
+
+            bool exiting;
+
+            {
+                std::scoped_lock _ (mutex);
+                exiting = should_exit;
+            }
+
+            if (! exiting && ! has_published())
+                sleeping.wait (true);
+
+            sleeping.store (false, std::memory_order_relaxed);
+
+            {
+                std::unique_lock lock (mutex);
+                condition.wait_for (lock, interval, [this] { return should_exit || flush_requested; });
+
+                if (should_exit)
+                    return;
+
+                flush_requested = false;
+            }
+
+            collect();
+
+            // Lock so a flush can't miss the notification between checking and waiting
+            { std::scoped_lock _ (mutex); }
+            condition.notify_all();
+        }
+    }
+
+    /** True if the object at the head of the queue has been published, only
+        called by the background thread.
+    */
+    bool has_published() const
+    {
+        const auto pos = head.load (std::memory_order_relaxed);
+        // seq_cst: ordered after advertising that we're going to sleep
+        return slots[pos & mask].sequence.load() == pos + 1;
+    }
+
+    /** Destroys everything that has been published, must only be called by
+        one thread at a time.
+    */
+    void collect()
+    {
+        auto pos = head.load (std::memory_order_relaxed);
+        const auto backlog = tail.load (std::memory_order_relaxed) - pos;
+
+        if (backlog == 0)
+            return;
+
+        if (backlog > max_backlog.load (std::memory_order_relaxed))
+            max_backlog.store (backlog, std::memory_order_relaxed);
+
+        for (;; ++pos)
+        {
+            auto& s = slots[pos & mask];
+
+            // acquire: see the object published by defer
+            if (s.sequence.load (std::memory_order_acquire) != pos + 1)
+                break;
+
+            s.object = nullptr;
+            // release: the slot can be reused once the object has gone
+            s.sequence.store (pos + slots.size(), std::memory_order_release);
+            head.store (pos + 1, std::memory_order_release);
+        }
+
+        num_batches.store (num_batches.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+template<std::size_t ObjectCapacity>
+struct is_sync<deferred_delete<ObjectCapacity>> : std::true_type {};
+
+}
@@ -0,0 +1,120 @@
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <ranges>
+#include <thread>
+#include <vector>
+#include "arc.h"
+#include "deferred_delete.h"
+#include "safe_thread.h"
+
+struct state
+{
+    ~state()
+    {
+        if (std::this_thread::get_id() != created_on)
+            ++num_destroyed_on_other_thread;
+
+        ++num_destroyed;
+    }
+
+    std::vector<float> buffer = std::vector<float> (1024);
+    const std::thread::id created_on = std::this_thread::get_id();
+
+    static inline std::atomic<int> num_destroyed { 0 }, num_destroyed_on_other_thread { 0 };
+};
+
+static_assert(scl::is_send_v<scl::detail::deferred_object<std::unique_ptr<state>>>);
+static_assert(! scl::is_send_v<scl::detail::deferred_object<state*>>);
+static_assert(scl::is_sync_v<scl::deferred_delete<>>);
+
+void reset_counts()
+{
+    state::num_destroyed = 0;
+    state::num_destroyed_on_other_thread = 0;
+}
+
+void test_destroyed_on_background_thread()
+{
+    reset_counts();
+    scl::deferred_delete reclaimer;
+
+    for ([[maybe_unused]] auto i : std::views::iota (0, 100))
+    {
+        [[maybe_unused]] const auto deferred = reclaimer.defer (std::make_unique<state>());
+        assert(deferred);
+    }
+
+    reclaimer.flush();
+    assert(state::num_destroyed == 100);
+    assert(state::num_destroyed_on_other_thread == 100);
+
+    [[maybe_unused]] const auto stats = reclaimer.stats();
+    assert(stats.deferred == 100);
+    assert(stats.deleted == 100);
+    assert(stats.backlog == 0);
+    assert(stats.rejected == 0);
+    assert(stats.batches >= 1);
+    assert(stats.max_backlog >= 1 && stats.max_backlog <= 100);
+}
+
+void test_full_queue()
+{
+    reset_counts();
+
+    {
+        // Long interval so nothing gets collected during the test
+        scl::deferred_delete reclaimer (4, std::chrono::hours (1));
+
+        for ([[maybe_unused]] auto i : std::views::iota (0, 4))
+            reclaimer.defer (std::make_unique<state>());
+
+        // The queue is full so ownership stays with the caller
+        auto rejected = std::make_unique<state>();
+        [[maybe_unused]] const auto deferred = reclaimer.defer (std::move (rejected));
+        assert(! deferred);
+        assert(rejected);
+
+        [[maybe_unused]] const auto stats = reclaimer.stats();
+        assert(stats.backlog == 4);
+        assert(stats.rejected == 1);
+        assert(state::num_destroyed == 0);
+    }
+
+    // The rest are destroyed when the reclaimer is
+    assert(state::num_destroyed == 5);
+}
+
+std::atomic<int> num_deferred { 0 };
+
+void defer_states (scl::arc<scl::deferred_delete<>> reclaimer)
+{
+    for ([[maybe_unused]] auto j : std::views::iota (0, 1'000))
+        if (auto s = std::make_shared<state>(); reclaimer->defer (std::move (s)))
+            ++num_deferred;
+}
+
+void test_multiple_producers()
+{
+    reset_counts();
+    num_deferred = 0;
+    auto reclaimer = scl::make_arc<scl::deferred_delete<>> (256);
+
+    {
+        std::vector<scl::thread> threads;
+
+        for ([[maybe_unused]] auto i : std::views::iota (0, 4))
+            threads.push_back (scl::thread (defer_states, auto (reclaimer)));
+    }
+
+    reclaimer->flush();
+    assert(state::num_destroyed == 4'000);
+    assert(static_cast<int> (reclaimer->stats().deleted) == num_deferred);
+}
+
+int main()
+{
+    test_destroyed_on_background_thread();
+    test_full_queue();
+    test_multiple_producers();
+}
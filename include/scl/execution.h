@@ -0,0 +1,712 @@
+#pragma once
+
+#include "sync_send.h"
+#include <algorithm>
+#include <concepts>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// A minimal implementation of the P2300 (std::execution) sender/receiver
+// model, enough to compose asynchronous pipelines across schedulers without
+// allocating a future for each step.
+//
+// - A receiver has set_value(values...), set_error(std::exception_ptr) and
+//   set_stopped() member functions.
+// - A sender describes work. It declares the values it completes with as
+//   value_types (a std::tuple) and is connected to a receiver to produce an
+//   operation state, which is started to run the work.
+// - A scheduler has a schedule() member returning a sender that completes on
+//   the scheduler's execution context.
+//
+// Operation states are never moved once connected so they can be linked in
+// to a scheduler's queue without any allocation.
+//
+// The only point where values move between threads is continues_on, so that
+// is where they are checked to be send. The functions passed to then aren't
+// checked: send rejects every lambda and callable class as it can't see their
+// captures, which would rule out lambdas altogether. A function that runs on
+// another scheduler, e.g. after schedule(), mustn't capture anything by
+// reference that isn't sync, just as with std::thread.
+
+namespace scl::execution {
+
+//================================================================================
+// Concepts
+//================================================================================
+template<typename R>
+concept receiver = std::move_constructible<std::remove_cvref_t<R>>
+                && requires (std::remove_cvref_t<R>& r)
+                   {
+                       r.set_error (std::exception_ptr());
+                       r.set_stopped();
+                   };
+
+template<typename O>
+concept operation_state = requires (O& o)
+                          {
+                              { o.start() } noexcept;
+                          };
+
+template<typename S>
+concept sender = std::move_constructible<std::remove_cvref_t<S>>
+              && requires { typename std::remove_cvref_t<S>::value_types; };
+
+template<sender S>
+using value_types_of_t = typename std::remove_cvref_t<S>::value_types;
+
+template<typename S, typename R>
+concept sender_to = sender<S>
+                 && receiver<R>
+                 && requires (S&& s, R&& r)
+                    {
+                        { std::forward<S> (s).connect (std::forward<R> (r)) } -> operation_state;
+                    };
+
+template<typename S>
+concept scheduler = std::copy_constructible<std::remove_cvref_t<S>>
+                 && std::equality_comparable<std::remove_cvref_t<S>>
+                 && requires (S&& s)
+                    {
+                        { s.schedule() } -> sender;
+                    };
+
+//================================================================================
+// Customisation points
+//================================================================================
+template<typename S, typename R>
+    requires sender_to<S, R>
+auto connect (S&& s, R&& r)
+{
+    return std::forward<S> (s).connect (std::forward<R> (r));
+}
+
+template<typename S, typename R>
+using connect_result_t = decltype (execution::connect (std::declval<S>(), std::declval<R>()));
+
+template<operation_state O>
+void start (O& o) noexcept
+{
+    o.start();
+}
+
+template<scheduler S>
+auto schedule (S&& s)
+{
+    return s.schedule();
+}
+
+template<scheduler S>
+using schedule_result_t = decltype (execution::schedule (std::declval<S>()));
+
+
+//================================================================================
+// Adaptor closures, so senders can be piped: just (1) | then (f)
+//================================================================================
+namespace detail {
+template<typename Fn>
+struct adaptor_closure
+{
+    Fn fn;
+
+    template<sender S>
+    friend auto operator| (S&& s, adaptor_closure c)
+    {
+        return std::move (c.fn) (std::forward<S> (s));
+    }
+};
+
+template<typename Fn>
+adaptor_closure (Fn) -> adaptor_closure<Fn>;
+
+template<typename R, typename... Vs>
+void set_value_or_error (R& r, Vs&&... vs) noexcept
+{
+    try
+    {
+        r.set_value (std::forward<Vs> (vs)...);
+    }
+    catch (...)
+    {
+        r.set_error (std::current_exception());
+    }
+}
+}
+
+
+//================================================================================
+// just
+//================================================================================
+template<typename... Ts>
+struct just_sender
+{
+    using value_types = std::tuple<Ts...>;
+
+    template<receiver R>
+    struct operation
+    {
+        std::tuple<Ts...> values;
+        R r;
+
+        void start() noexcept
+        {
+            std::apply ([this] (Ts&... vs) { detail::set_value_or_error (r, std::move (vs)...); }, values);
+        }
+    };
+
+    template<receiver R>
+    operation<std::remove_cvref_t<R>> connect (R&& r) &&
+    {
+        return { std::move (values), std::forward<R> (r) };
+    }
+
+    std::tuple<Ts...> values;
+};
+
+/** Returns a sender that completes immediately with vs. */
+template<typename... Ts>
+just_sender<std::decay_t<Ts>...> just (Ts&&... vs)
+{
+    return { { std::forward<Ts> (vs)... } };
+}
+
+
+//================================================================================
+// then
+//================================================================================
+namespace detail {
+template<typename F, typename Tuple>
+struct then_values;
+
+template<typename F, typename... Ts>
+struct then_values<F, std::tuple<Ts...>>
+{
+    using result = std::invoke_result_t<F, Ts...>;
+    using type = std::conditional_t<std::is_void_v<result>, std::tuple<>, std::tuple<std::decay_t<result>>>;
+};
+}
+
+template<sender S, typename F>
+struct then_sender
+{
+    using value_types = typename detail::then_values<F, value_types_of_t<S>>::type;
+
+    template<receiver R>
+    struct then_receiver
+    {
+        R r;
+        F f;
+
+        template<typename... Vs>
+        void set_value (Vs&&... vs)
+        {
+            try
+            {
+                if constexpr (std::is_void_v<std::invoke_result_t<F, Vs...>>)
+                {
+                    std::invoke (std::move (f), std::forward<Vs> (vs)...);
+                    r.set_value();
+                }
+                else
+                {
+                    r.set_value (std::invoke (std::move (f), std::forward<Vs> (vs)...));
+                }
+            }
+            catch (...)
+            {
+                r.set_error (std::current_exception());
+            }
+        }
+
+        void set_error (std::exception_ptr e)   { r.set_error (std::move (e)); }
+        void set_stopped()                      { r.set_stopped(); }
+    };
+
+    template<receiver R>
+    auto connect (R&& r) &&
+    {
+        return execution::connect (std::move (child), then_receiver<std::remove_cvref_t<R>> { std::forward<R> (r), std::move (f) });
+    }
+
+    S child;
+    F f;
+};
+
+/** Returns a sender that calls f with the values of s and completes with the result.
+    N.B. f isn't checked to be send even though it runs wherever s completes,
+    see the note at the top of this file.
+*/
+template<sender S, typename F>
+then_sender<std::remove_cvref_t<S>, std::decay_t<F>> then (S&& s, F&& f)
+{
+    return { std::forward<S> (s), std::forward<F> (f) };
+}
+
+template<typename F>
+auto then (F&& f)
+{
+    return detail::adaptor_closure { [f = std::forward<F> (f)] (auto&& s) mutable
+                                     {
+                                         return execution::then (std::forward<decltype (s)> (s), std::move (f));
+                                     } };
+}
+
+
+//================================================================================
+// continues_on
+//================================================================================
+namespace detail {
+/** The values held while moving from one scheduler to another. Forming this
+    type for values that aren't send fails, rejecting the pipeline.
+*/
+template<send... Ts>
+struct crossing_values
+{
+    using type = std::tuple<Ts...>;
+};
+
+template<typename Tuple>
+struct crossing_values_of;
+
+template<typename... Ts>
+struct crossing_values_of<std::tuple<Ts...>>
+{
+    using type = typename crossing_values<Ts...>::type;
+};
+}
+
+template<sender S, scheduler Sch>
+struct continues_on_sender
+{
+    using value_types = typename detail::crossing_values_of<value_types_of_t<S>>::type;
+
+    template<receiver R>
+    struct operation
+    {
+        struct child_receiver
+        {
+            operation* op;
+
+            template<typename... Vs>
+            void set_value (Vs&&... vs) noexcept
+            {
+                try
+                {
+                    op->values.emplace (std::forward<Vs> (vs)...);
+                }
+                catch (...)
+                {
+                    op->r.set_error (std::current_exception());
+                    return;
+                }
+
+                execution::start (op->schedule_op);
+            }
+
+            void set_error (std::exception_ptr e)   { op->r.set_error (std::move (e)); }
+            void set_stopped()                      { op->r.set_stopped(); }
+        };
+
+        struct schedule_receiver
+        {
+            operation* op;
+
+            void set_value()
+            {
+                std::apply ([this] (auto&... vs) { op->r.set_value (std::move (vs)...); }, *op->values);
+            }
+
+            void set_error (std::exception_ptr e)   { op->r.set_error (std::move (e)); }
+            void set_stopped()                      { op->r.set_stopped(); }
+        };
+
+        operation (S&& s, Sch sch, R receiver_to_use)
+            : r (std::move (receiver_to_use)),
+              child_op (execution::connect (std::move (s), child_receiver { this })),
+              schedule_op (execution::connect (execution::schedule (sch), schedule_receiver { this }))
+        {}
+
+        operation (const operation&) = delete;
+        operation& operator= (const operation&) = delete;
+
+        void start() noexcept
+        {
+            execution::start (child_op);
+        }
+
+        R r;
+        std::optional<value_types> values;
+        connect_result_t<S, child_receiver> child_op;
+        connect_result_t<schedule_result_t<Sch&>, schedule_receiver> schedule_op;
+    };
+
+    template<receiver R>
+    operation<std::remove_cvref_t<R>> connect (R&& r) &&
+    {
+        return { std::move (child), std::move (sch), std::forward<R> (r) };
+    }
+
+    S child;
+    Sch sch;
+};
+
+/** Returns a sender that completes with the values of s but on sch.
+    The values are moved to sch's execution context so must be send.
+*/
+template<sender S, scheduler Sch>
+continues_on_sender<std::remove_cvref_t<S>, std::remove_cvref_t<Sch>> continues_on (S&& s, Sch&& sch)
+{
+    return { std::forward<S> (s), std::forward<Sch> (sch) };
+}
+
+template<scheduler Sch>
+auto continues_on (Sch&& sch)
+{
+    return detail::adaptor_closure { [sch = std::forward<Sch> (sch)] (auto&& s) mutable
+                                     {
+                                         return execution::continues_on (std::forward<decltype (s)> (s), std::move (sch));
+                                     } };
+}
+
+
+//================================================================================
+// sync_wait
+//================================================================================
+namespace detail {
+template<typename Values>
+struct sync_wait_state
+{
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::variant<std::monostate, Values, std::exception_ptr, std::nullopt_t> result;
+    bool done = false;
+
+    template<typename T>
+    void complete (T&& t)
+    {
+        // Notify under the lock as the waiter destroys this once it sees done
+        std::scoped_lock _ (mutex);
+        result = std::forward<T> (t);
+        done = true;
+        condition.notify_one();
+    }
+};
+
+template<typename Values>
+struct sync_wait_receiver
+{
+    sync_wait_state<Values>* state;
+
+    template<typename... Vs>
+    void set_value (Vs&&... vs)                 { state->complete (Values (std::forward<Vs> (vs)...)); }
+    void set_error (std::exception_ptr e)       { state->complete (std::move (e)); }
+    void set_stopped()                          { state->complete (std::nullopt); }
+};
+}
+
+/** Starts s and blocks until it completes. Returns the values, an empty
+    optional if it was stopped or rethrows any error.
+*/
+template<sender S>
+std::optional<value_types_of_t<S>> sync_wait (S&& s)
+{
+    using values = value_types_of_t<S>;
+    detail::sync_wait_state<values> state;
+
+    auto op = execution::connect (std::forward<S> (s), detail::sync_wait_receiver<values> { &state });
+    execution::start (op);
+
+    std::unique_lock lock (state.mutex);
+    state.condition.wait (lock, [&] { return state.done; });
+
+    if (auto e = std::get_if<std::exception_ptr> (&state.result))
+        std::rethrow_exception (*e);
+
+    if (auto v = std::get_if<values> (&state.result))
+        return std::move (*v);
+
+    return std::nullopt;
+}
+
+
+//================================================================================
+// Schedulers
+//================================================================================
+/** Runs work immediately on the thread that starts it. */
+class inline_scheduler
+{
+public:
+    struct schedule_sender
+    {
+        using value_types = std::tuple<>;
+
+        template<receiver R>
+        struct operation
+        {
+            R r;
+
+            void start() noexcept
+            {
+                detail::set_value_or_error (r);
+            }
+        };
+
+        template<receiver R>
+        operation<std::remove_cvref_t<R>> connect (R&& r) const
+        {
+            return { std::forward<R> (r) };
+        }
+    };
+
+    schedule_sender schedule() const noexcept
+    {
+        return {};
+    }
+
+    bool operator== (const inline_scheduler&) const = default;
+};
+
+
+namespace detail {
+/** An operation state waiting in a queue. */
+struct task_base
+{
+    task_base* next = nullptr;
+    void (*execute) (task_base*) noexcept = nullptr;
+};
+
+/** An intrusive FIFO of tasks that threads can block on. */
+class task_queue
+{
+public:
+    void push (task_base& t)
+    {
+        {
+            std::scoped_lock _ (mutex);
+            t.next = nullptr;
+
+            if (tail)
+                tail->next = &t;
+            else
+                head = &t;
+
+            tail = &t;
+        }
+
+        condition.notify_one();
+    }
+
+    /** Returns the next task, blocking until there is one or nullptr once
+        finished and empty.
+    */
+    task_base* pop()
+    {
+        std::unique_lock lock (mutex);
+        condition.wait (lock, [this] { return head || finishing; });
+
+        auto t = head;
+
+        if (t)
+        {
+            head = t->next;
+
+            if (! head)
+                tail = nullptr;
+        }
+
+        return t;
+    }
+
+    void finish()
+    {
+        {
+            std::scoped_lock _ (mutex);
+            finishing = true;
+        }
+
+        condition.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable condition;
+    task_base* head = nullptr;
+    task_base* tail = nullptr;
+    bool finishing = false;
+};
+
+/** A sender that completes on whichever thread pops it from queue. */
+struct queue_schedule_sender
+{
+    using value_types = std::tuple<>;
+
+    template<receiver R>
+    struct operation : task_base
+    {
+        operation (task_queue& q, R receiver_to_use)
+            : queue (q), r (std::move (receiver_to_use))
+        {
+            execute = [] (task_base* t) noexcept
+            {
+                set_value_or_error (static_cast<operation*> (t)->r);
+            };
+        }
+
+        operation (const operation&) = delete;
+        operation& operator= (const operation&) = delete;
+
+        void start() noexcept
+        {
+            queue.push (*this);
+        }
+
+        task_queue& queue;
+        R r;
+    };
+
+    template<receiver R>
+    operation<std::remove_cvref_t<R>> connect (R&& r) const
+    {
+        return { *queue, std::forward<R> (r) };
+    }
+
+    task_queue* queue;
+};
+}
+
+
+/** Runs work on the thread that calls run(), until finish() is called and
+    the queue is empty.
+*/
+class run_loop
+{
+public:
+    class scheduler_type
+    {
+    public:
+        detail::queue_schedule_sender schedule() const noexcept
+        {
+            return { &loop->queue };
+        }
+
+        bool operator== (const scheduler_type&) const = default;
+
+    private:
+        friend run_loop;
+
+        explicit scheduler_type (run_loop& l)
+            : loop (&l)
+        {}
+
+        run_loop* loop;
+    };
+
+    run_loop() = default;
+    run_loop (const run_loop&) = delete;
+    run_loop& operator= (const run_loop&) = delete;
+
+    scheduler_type get_scheduler() noexcept
+    {
+        return scheduler_type (*this);
+    }
+
+    /** Runs queued work until finish() is called and there's none left. */
+    void run()
+    {
+        while (auto t = queue.pop())
+            t->execute (t);
+    }
+
+    void finish()
+    {
+        queue.finish();
+    }
+
+private:
+    detail::task_queue queue;
+};
+
+
+/** Runs work on a fixed number of threads. Work queued when the pool is
+    destroyed is run before the threads exit.
+*/
+class static_thread_pool
+{
+public:
+    class scheduler_type
+    {
+    public:
+        detail::queue_schedule_sender schedule() const noexcept
+        {
+            return { &pool->queue };
+        }
+
+        bool operator== (const scheduler_type&) const = default;
+
+    private:
+        friend static_thread_pool;
+
+        explicit scheduler_type (static_thread_pool& p)
+            : pool (&p)
+        {}
+
+        static_thread_pool* pool;
+    };
+
+    explicit static_thread_pool (std::size_t num_threads = std::max (std::thread::hardware_concurrency(), 1u))
+    {
+        for (std::size_t i = 0; i < std::max<std::size_t> (num_threads, 1); ++i)
+            threads.emplace_back ([this]
+                                  {
+                                      while (auto t = queue.pop())
+                                          t->execute (t);
+                                  });
+    }
+
+    static_thread_pool (const static_thread_pool&) = delete;
+    static_thread_pool& operator= (const static_thread_pool&) = delete;
+
+    ~static_thread_pool()
+    {
+        queue.finish();
+
+        for (auto& t : threads)
+            t.join();
+    }
+
+    scheduler_type get_scheduler() noexcept
+    {
+        return scheduler_type (*this);
+    }
+
+    std::size_t num_threads() const
+    {
+        return threads.size();
+    }
+
+private:
+    detail::task_queue queue;
+    std::vector<std::thread> threads;
+};
+
+static_assert (scheduler<inline_scheduler>);
+static_assert (scheduler<run_loop::scheduler_type>);
+static_assert (scheduler<static_thread_pool::scheduler_type>);
+
+}
+
+namespace scl {
+template<>
+struct is_sync<execution::run_loop> : std::true_type {};
+
+template<>
+struct is_sync<execution::static_thread_pool> : std::true_type {};
+}
@@ -0,0 +1,113 @@
+#include <cassert>
+#include <memory>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include "execution.h"
+
+namespace ex = scl::execution;
+
+static_assert(ex::sender<decltype (ex::just (1, std::string()))>);
+static_assert(std::is_same_v<ex::value_types_of_t<decltype (ex::just (1) | ex::then ([] (int) {}))>, std::tuple<>>);
+static_assert(scl::is_sync_v<ex::static_thread_pool>);
+
+void test_inline()
+{
+    auto s = ex::just (20, 1)
+           | ex::then ([] (int a, int b) { return a * 2 + b; })
+           | ex::continues_on (ex::inline_scheduler())
+           | ex::then ([] (int v) { return std::to_string (v); });
+
+    [[maybe_unused]] auto result = ex::sync_wait (std::move (s));
+    assert(result);
+    assert(std::get<0> (*result) == "41");
+}
+
+void test_errors()
+{
+    auto s = ex::just (1)
+           | ex::then ([] (int) -> int { throw std::runtime_error ("failed"); })
+           | ex::then ([] (int v) { return v + 1; });
+
+    [[maybe_unused]] bool caught = false;
+
+    try
+    {
+        ex::sync_wait (std::move (s));
+    }
+    catch (const std::runtime_error&)
+    {
+        caught = true;
+    }
+
+    assert(caught);
+}
+
+void test_run_loop()
+{
+    ex::run_loop loop;
+    [[maybe_unused]] const auto loop_thread_id = std::this_thread::get_id();
+    std::optional<std::tuple<std::thread::id>> result;
+
+    // Values move from a worker thread back to the thread running the loop
+    std::thread worker ([&]
+                        {
+                            auto s = ex::just (std::make_unique<int> (42))
+                                   | ex::continues_on (loop.get_scheduler())
+                                   | ex::then ([] ([[maybe_unused]] std::unique_ptr<int> v)
+                                               {
+                                                   assert(*v == 42);
+                                                   return std::this_thread::get_id();
+                                               });
+
+                            result = ex::sync_wait (std::move (s));
+                            loop.finish();
+                        });
+
+    loop.run();
+    worker.join();
+
+    assert(result);
+    assert(std::get<0> (*result) == loop_thread_id);
+}
+
+void test_thread_pool()
+{
+    constexpr int num_tasks = 1'000;
+    ex::static_thread_pool pool (4);
+    assert(pool.num_threads() == 4);
+
+    auto sch = pool.get_scheduler();
+    assert(sch == pool.get_scheduler());
+
+    const auto caller_id = std::this_thread::get_id();
+    int num_on_pool = 0, total = 0;
+
+    for (auto i : std::views::iota (0, num_tasks))
+    {
+        // The continuation only captures by value and hands its results back
+        // through continues_on, which checks they're send
+        auto s = ex::schedule (sch)
+               | ex::then ([i, caller_id] { return std::pair (i, std::this_thread::get_id() != caller_id); })
+               | ex::continues_on (ex::inline_scheduler());
+
+        const auto [value, ran_on_pool] = std::get<0> (*ex::sync_wait (std::move (s)));
+        total += value;
+        num_on_pool += ran_on_pool ? 1 : 0;
+    }
+
+    assert(num_on_pool == num_tasks);
+    assert(total == num_tasks * (num_tasks - 1) / 2);
+}
+
+int main()
+{
+    test_inline();
+    test_errors();
+    test_run_loop();
+    test_thread_pool();
+
+    return 0;
+}
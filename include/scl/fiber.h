@@ -0,0 +1,614 @@
+#pragma once
+
+#if defined (__linux__)
+
+#include "sync_send.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+namespace scl {
+
+class fiber_scheduler;
+
+namespace detail {
+/** A lock for the short internal critical sections of the fiber primitives. */
+class fiber_spin_lock
+{
+public:
+    void lock() noexcept
+    {
+        while (flag.test_and_set (std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+
+    void unlock() noexcept
+    {
+        flag.clear (std::memory_order_release);
+    }
+
+private:
+    std::atomic_flag flag;
+};
+
+struct fiber
+{
+    ucontext_t context;
+    std::byte* stack = nullptr;
+    std::move_only_function<void()> body;
+    fiber_scheduler* scheduler = nullptr;
+    bool finished = false;
+};
+
+/** What a worker should do with a fiber once it has switched away from it.
+    This has to happen after the switch as another worker could otherwise
+    resume the fiber while it's still running on this one.
+*/
+struct fiber_worker
+{
+    ucontext_t context;
+    fiber* current = nullptr;
+    fiber_spin_lock* unlock_after_switch = nullptr;
+    bool reschedule_after_switch = false;
+};
+
+// Fibers can resume on a different thread so this must be re-read after
+// every switch rather than the compiler reusing the address
+[[gnu::noinline]] inline fiber_worker*& this_thread_fiber_worker()
+{
+    thread_local fiber_worker* worker = nullptr;
+    return worker;
+}
+
+/** Something blocked on a fiber_mutex or fiber_condition_variable, either a
+    fiber or an OS thread.
+*/
+struct fiber_waiter
+{
+    fiber* f = nullptr;
+    std::atomic<bool> ready { false };
+    fiber_waiter* next = nullptr;
+};
+
+struct fiber_waiter_queue
+{
+    void push (fiber_waiter& w)
+    {
+        if (tail)
+            tail->next = &w;
+        else
+            head = &w;
+
+        tail = &w;
+    }
+
+    fiber_waiter* pop()
+    {
+        auto w = head;
+
+        if (w)
+        {
+            head = w->next;
+
+            if (! head)
+                tail = nullptr;
+        }
+
+        return w;
+    }
+
+    fiber_waiter* head = nullptr;
+    fiber_waiter* tail = nullptr;
+};
+
+inline void block (fiber_waiter&, fiber_spin_lock&);
+inline void wake (fiber_waiter&);
+inline void yield_fiber();
+}
+
+//==========================================
+//==========================================
+/**
+ *  Runs stackful fibers on a small pool of OS threads (M:N scheduling).
+ *
+ *  Fibers are much cheaper than threads to create and block so thousands of
+ *  mostly blocked tasks can be run on a few threads. A fiber runs until it
+ *  finishes or blocks on a fiber_mutex, fiber_condition_variable or
+ *  this_fiber::yield(), at which point its worker thread runs another fiber.
+ *
+ *  A blocked fiber can resume on a different thread so, like scl::thread,
+ *  the function and arguments given to spawn must be send. For the same
+ *  reason fibers shouldn't rely on thread_local state across blocking calls.
+ *
+ *  Stacks are allocated with a guard page and reused for later fibers. Only
+ *  available on Linux as it uses ucontext to switch stacks.
+ *
+ *  @code
+ *  scl::fiber_scheduler scheduler (4);
+ *  for (auto i : std::views::iota (0, 10'000))
+ *      scheduler.spawn (handle_connection, auto (i));
+ *  scheduler.wait();
+ *  @endcode
+ */
+class fiber_scheduler
+{
+public:
+    struct statistics
+    {
+        std::size_t spawned = 0;            // Fibers created
+        std::size_t finished = 0;           // Fibers that have returned
+        std::size_t stacks_allocated = 0;   // Stacks allocated from the system
+        std::size_t stacks_reused = 0;      // Stacks taken from the pool
+        std::size_t switches = 0;           // Times a worker switched to a fiber
+    };
+
+    /** Creates num_threads workers that run fibers with stack_size byte stacks. */
+    explicit fiber_scheduler (std::size_t num_threads = std::max (std::thread::hardware_concurrency(), 1u),
+                              std::size_t stack_size = 64 * 1024)
+        : page_size (static_cast<std::size_t> (sysconf (_SC_PAGESIZE))),
+          stack_bytes ((std::max (stack_size, page_size) + page_size - 1) / page_size * page_size)
+    {
+        for (std::size_t i = 0; i < std::max<std::size_t> (num_threads, 1); ++i)
+            workers.emplace_back ([this] { run_worker(); });
+    }
+
+    /** Waits for all the fibers to finish then stops the workers. */
+    ~fiber_scheduler()
+    {
+        wait();
+
+        {
+            std::scoped_lock _ (queue_mutex);
+            should_exit = true;
+        }
+
+        queue_condition.notify_all();
+
+        for (auto& w : workers)
+            w.join();
+
+        for (auto s : stack_pool)
+            munmap (s, stack_bytes + page_size);
+    }
+
+    fiber_scheduler (const fiber_scheduler&) = delete;
+    fiber_scheduler& operator= (const fiber_scheduler&) = delete;
+
+    /** Starts a fiber calling f with args. */
+    template<typename F, send... Args>
+    void spawn (F&& f, Args&&... args)
+    {
+        // N.B. We can't constrain F to the concept due to recursion of is_move_constructable
+        // So we have to statically assert it
+        static_assert (send<F>);
+
+        auto stack = take_stack();
+        auto fb = new detail::fiber();
+        fb->stack = stack;
+        fb->scheduler = this;
+        fb->body = [fn = std::forward<F> (f), ... a = pass_argument (std::forward<Args> (args))] () mutable
+                   {
+                       std::invoke (std::move (fn), std::move (a)...);
+                   };
+
+        getcontext (&fb->context);
+        fb->context.uc_stack.ss_sp = fb->stack;
+        fb->context.uc_stack.ss_size = stack_bytes;
+        fb->context.uc_link = nullptr;
+
+        // makecontext only passes int arguments so the pointer is split in two
+        const auto address = reinterpret_cast<std::uintptr_t> (fb);
+        makecontext (&fb->context, reinterpret_cast<void (*)()> (&fiber_entry), 2,
+                     static_cast<unsigned> (address), static_cast<unsigned> (address >> 32));
+
+        num_live.fetch_add (1, std::memory_order_relaxed);
+        num_spawned.fetch_add (1, std::memory_order_relaxed);
+        schedule (*fb);
+    }
+
+    /** Blocks until every fiber spawned so far has finished.
+        Must not be called from one of this scheduler's fibers.
+    */
+    void wait()
+    {
+        std::unique_lock lock (live_mutex);
+        live_condition.wait (lock, [this] { return num_live.load (std::memory_order_acquire) == 0; });
+    }
+
+    std::size_t num_threads() const
+    {
+        return workers.size();
+    }
+
+    statistics stats() const
+    {
+        statistics s;
+        s.spawned           = num_spawned.load (std::memory_order_relaxed);
+        s.finished          = num_finished.load (std::memory_order_relaxed);
+        s.stacks_allocated  = num_stacks_allocated.load (std::memory_order_relaxed);
+        s.stacks_reused     = num_stacks_reused.load (std::memory_order_relaxed);
+        s.switches          = num_switches.load (std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    friend void detail::block (detail::fiber_waiter&, detail::fiber_spin_lock&);
+    friend void detail::wake (detail::fiber_waiter&);
+    friend void detail::yield_fiber();
+
+    const std::size_t page_size, stack_bytes;
+    std::vector<std::thread> workers;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_condition;
+    std::deque<detail::fiber*> run_queue;
+    bool should_exit = false;
+
+    std::mutex stack_mutex;
+    std::vector<std::byte*> stack_pool;
+
+    std::mutex live_mutex;
+    std::condition_variable live_condition;
+    std::atomic<std::size_t> num_live { 0 };
+
+    std::atomic<std::size_t> num_spawned { 0 }, num_finished { 0 }, num_switches { 0 },
+                             num_stacks_allocated { 0 }, num_stacks_reused { 0 };
+
+    //==========================================
+    /** References are only send if their type opts in (e.g. synchronized_value&)
+        so are shared rather than copied.
+    */
+    template<typename T>
+    static auto pass_argument (T&& arg)
+    {
+        if constexpr (std::is_lvalue_reference_v<T>)
+            return std::ref (arg);
+        else
+            return std::forward<T> (arg);
+    }
+
+    /** Returns the usable part of a stack, below it is an inaccessible guard
+        page so an overflow crashes rather than corrupting memory.
+    */
+    std::byte* take_stack()
+    {
+        {
+            std::scoped_lock _ (stack_mutex);
+
+            if (! stack_pool.empty())
+            {
+                auto s = stack_pool.back();
+                stack_pool.pop_back();
+                num_stacks_reused.fetch_add (1, std::memory_order_relaxed);
+                return s + page_size;
+            }
+        }
+
+        auto memory = mmap (nullptr, stack_bytes + page_size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+
+        if (memory == MAP_FAILED)
+            throw std::bad_alloc();
+
+        // Without the guard page an overflow would silently corrupt memory
+        if (mprotect (memory, page_size, PROT_NONE) != 0)
+        {
+            const auto error = errno;
+            munmap (memory, stack_bytes + page_size);
+            throw std::system_error (error, std::generic_category(), "Failed to protect the fiber stack guard page");
+        }
+
+        num_stacks_allocated.fetch_add (1, std::memory_order_relaxed);
+        return static_cast<std::byte*> (memory) + page_size;
+    }
+
+    void return_stack (std::byte* s)
+    {
+        std::scoped_lock _ (stack_mutex);
+        stack_pool.push_back (s - page_size);
+    }
+
+    void schedule (detail::fiber& fb)
+    {
+        {
+            std::scoped_lock _ (queue_mutex);
+            run_queue.push_back (&fb);
+        }
+
+        queue_condition.notify_one();
+    }
+
+    static void fiber_entry (unsigned low, unsigned high)
+    {
+        auto fb = reinterpret_cast<detail::fiber*> (static_cast<std::uintptr_t> (low)
+                                                    | (static_cast<std::uintptr_t> (high) << 32));
+
+        // Like std::thread, an escaping exception terminates
+        try
+        {
+            fb->body();
+        }
+        catch (...)
+        {
+            std::terminate();
+        }
+
+        fb->body = nullptr;
+        fb->finished = true;
+        swapcontext (&fb->context, &detail::this_thread_fiber_worker()->context);
+    }
+
+    /** Switches from the current fiber back to its worker. */
+    static void suspend (detail::fiber& fb)
+    {
+        swapcontext (&fb.context, &detail::this_thread_fiber_worker()->context);
+    }
+
+    void run_worker()
+    {
+        detail::fiber_worker worker;
+        detail::this_thread_fiber_worker() = &worker;
+
+        for (;;)
+        {
+            detail::fiber* fb = nullptr;
+
+            {
+                std::unique_lock lock (queue_mutex);
+                queue_condition.wait (lock, [this] { return should_exit || ! run_queue.empty(); });
+
+                if (run_queue.empty())
+                    return;
+
+                fb = run_queue.front();
+                run_queue.pop_front();
+            }
+
+            worker.current = fb;
+            num_switches.fetch_add (1, std::memory_order_relaxed);
+            swapcontext (&worker.context, &fb->context);
+            worker.current = nullptr;
+
+            // Once rescheduled or unlocked another worker could run the fiber
+            // so it mustn't be touched after that
+            if (fb->finished)
+                finish (fb);
+            else if (std::exchange (worker.reschedule_after_switch, false))
+                schedule (*fb);
+            else if (auto lock = std::exchange (worker.unlock_after_switch, nullptr))
+                lock->unlock();
+        }
+    }
+
+    void finish (detail::fiber* fb)
+    {
+        return_stack (fb->stack);
+        delete fb;
+        num_finished.fetch_add (1, std::memory_order_relaxed);
+
+        if (num_live.fetch_sub (1, std::memory_order_acq_rel) == 1)
+        {
+            // Lock so a waiter can't miss the notification between checking and waiting
+            { std::scoped_lock _ (live_mutex); }
+            live_condition.notify_all();
+        }
+    }
+};
+
+
+//==========================================
+namespace this_fiber {
+/** Returns true if called from a fiber. */
+inline bool is_fiber()
+{
+    auto worker = detail::this_thread_fiber_worker();
+    return worker && worker->current;
+}
+
+/** Lets other fibers run then continues, possibly on a different thread.
+    Yields the thread if not called from a fiber.
+*/
+inline void yield()
+{
+    if (is_fiber())
+        detail::yield_fiber();
+    else
+        std::this_thread::yield();
+}
+}
+
+namespace detail {
+inline void yield_fiber()
+{
+    auto worker = this_thread_fiber_worker();
+    worker->reschedule_after_switch = true;
+    fiber_scheduler::suspend (*worker->current);
+}
+
+/** Blocks the calling fiber or thread until woken. lock must be held and
+    is released once the caller can no longer miss a wake.
+*/
+inline void block (fiber_waiter& w, fiber_spin_lock& lock)
+{
+    if (auto worker = this_thread_fiber_worker(); worker && worker->current)
+    {
+        w.f = worker->current;
+        worker->unlock_after_switch = &lock;
+        fiber_scheduler::suspend (*w.f);
+        return;
+    }
+
+    lock.unlock();
+    w.ready.wait (false, std::memory_order_acquire);
+
+    // The waker holds the lock while notifying so wait for it to finish
+    // before w goes out of scope
+    lock.lock();
+    lock.unlock();
+}
+
+/** Resumes a blocked fiber or thread, the lock it blocked with must be held. */
+inline void wake (fiber_waiter& w)
+{
+    if (auto fb = w.f)
+    {
+        fb->scheduler->schedule (*fb);
+        return;
+    }
+
+    w.ready.store (true, std::memory_order_release);
+    w.ready.notify_one();
+}
+}
+
+
+//==========================================
+//==========================================
+/**
+ *  A mutex that blocks just the calling fiber, letting its thread run other
+ *  fibers. It can also be used from normal threads, which block as usual.
+ *
+ *  Ownership is handed directly to waiters in FIFO order. It meets the
+ *  Lockable requirements so can be used with std::scoped_lock and as the
+ *  mutex of a scl::synchronized_value.
+ */
+class fiber_mutex
+{
+public:
+    fiber_mutex() = default;
+    fiber_mutex (const fiber_mutex&) = delete;
+    fiber_mutex& operator= (const fiber_mutex&) = delete;
+
+    void lock()
+    {
+        spin.lock();
+
+        if (! locked)
+        {
+            locked = true;
+            spin.unlock();
+            return;
+        }
+
+        // Returns owning the mutex
+        detail::fiber_waiter w;
+        waiters.push (w);
+        detail::block (w, spin);
+    }
+
+    bool try_lock()
+    {
+        std::scoped_lock _ (spin);
+        return ! std::exchange (locked, true);
+    }
+
+    void unlock()
+    {
+        std::scoped_lock _ (spin);
+
+        if (auto w = waiters.pop())
+            detail::wake (*w);
+        else
+            locked = false;
+    }
+
+private:
+    detail::fiber_spin_lock spin;
+    bool locked = false;
+    detail::fiber_waiter_queue waiters;
+};
+
+
+//==========================================
+//==========================================
+/**
+ *  A condition variable that blocks just the calling fiber. Like
+ *  std::condition_variable_any it can be used with any lock, typically a
+ *  std::unique_lock<fiber_mutex>. Wakes are never spurious but other fibers
+ *  may change the state before a woken fiber runs so use the predicate
+ *  overload.
+ */
+class fiber_condition_variable
+{
+public:
+    fiber_condition_variable() = default;
+    fiber_condition_variable (const fiber_condition_variable&) = delete;
+    fiber_condition_variable& operator= (const fiber_condition_variable&) = delete;
+
+    template<typename Lock>
+    void wait (Lock& lock)
+    {
+        detail::fiber_waiter w;
+        spin.lock();
+        waiters.push (w);
+        lock.unlock();
+        detail::block (w, spin);
+        lock.lock();
+    }
+
+    template<typename Lock, typename Predicate>
+    void wait (Lock& lock, Predicate pred)
+    {
+        while (! pred())
+            wait (lock);
+    }
+
+    void notify_one()
+    {
+        std::scoped_lock _ (spin);
+
+        if (auto w = waiters.pop())
+            detail::wake (*w);
+    }
+
+    void notify_all()
+    {
+        std::scoped_lock _ (spin);
+
+        while (auto w = waiters.pop())
+            detail::wake (*w);
+    }
+
+private:
+    detail::fiber_spin_lock spin;
+    detail::fiber_waiter_queue waiters;
+};
+
+template<>
+struct is_sync<fiber_scheduler> : std::true_type {};
+
+template<>
+struct is_sync<fiber_mutex> : std::true_type {};
+
+template<>
+struct is_sync<fiber_condition_variable> : std::true_type {};
+
+// Like synchronized_value, these are designed to be shared by reference
+// with the fibers that use them
+template<>
+struct is_send<fiber_scheduler&> : std::true_type {};
+
+template<>
+struct is_send<fiber_mutex&> : std::true_type {};
+
+template<>
+struct is_send<fiber_condition_variable&> : std::true_type {};
+
+}
+
+#endif //__linux__
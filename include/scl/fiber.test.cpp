@@ -0,0 +1,144 @@
+#include "fiber.h"
+
+#if defined (__linux__)
+
+#include <cassert>
+#include <deque>
+#include <ranges>
+#include <thread>
+#include "synchronized_value.h"
+
+static_assert(scl::is_send_v<scl::synchronized_value<int, scl::fiber_mutex>&>);
+static_assert(scl::is_send_v<scl::fiber_mutex&>);
+
+void increment (scl::synchronized_value<int, scl::fiber_mutex>& counter, int n)
+{
+    for ([[maybe_unused]] auto i : std::views::iota (0, n))
+    {
+        apply ([] (int& c) { ++c; }, counter);
+        scl::this_fiber::yield();
+    }
+}
+
+void test_many_fibers()
+{
+    constexpr int num_fibers = 5'000, num_increments = 10;
+    scl::synchronized_value<int, scl::fiber_mutex> counter (0);
+
+    {
+        scl::fiber_scheduler scheduler (2, 16 * 1024);
+        assert(scheduler.num_threads() == 2);
+
+        for ([[maybe_unused]] auto i : std::views::iota (0, num_fibers))
+            scheduler.spawn (increment, counter, auto (num_increments));
+
+        scheduler.wait();
+
+        [[maybe_unused]] const auto stats = scheduler.stats();
+        assert(stats.spawned == num_fibers);
+        assert(stats.finished == num_fibers);
+        assert(stats.switches >= num_fibers * num_increments);
+
+        // Stacks are pooled rather than one per fiber
+        assert(stats.stacks_allocated + stats.stacks_reused == num_fibers);
+    }
+
+    [[maybe_unused]] const auto total = apply ([] (int c) { return c; }, counter);
+    assert(total == num_fibers * num_increments);
+}
+
+struct channel
+{
+    scl::fiber_mutex mutex;
+    scl::fiber_condition_variable condition;
+    std::deque<int> values;
+    bool closed = false;
+};
+
+template<>
+struct scl::is_send<channel&> : std::true_type {};
+
+void produce (channel& c, int first, int n)
+{
+    for (auto i : std::views::iota (first, first + n))
+    {
+        {
+            std::scoped_lock _ (c.mutex);
+            c.values.push_back (i);
+        }
+
+        c.condition.notify_one();
+    }
+}
+
+void consume (channel& c, scl::synchronized_value<long long, scl::fiber_mutex>& sum)
+{
+    for (;;)
+    {
+        std::unique_lock lock (c.mutex);
+        c.condition.wait (lock, [&] { return c.closed || ! c.values.empty(); });
+
+        if (c.values.empty())
+            return;
+
+        const auto v = c.values.front();
+        c.values.pop_front();
+        lock.unlock();
+
+        apply ([v] (long long& s) { s += v; }, sum);
+    }
+}
+
+void test_condition_variable()
+{
+    constexpr int num_producers = 4, num_values = 1'000;
+    channel c;
+    scl::synchronized_value<long long, scl::fiber_mutex> sum (0);
+
+    {
+        scl::fiber_scheduler scheduler (3);
+
+        for ([[maybe_unused]] auto i : std::views::iota (0, 8))
+            scheduler.spawn (consume, c, sum);
+
+        // Fiber primitives can be mixed with normal threads
+        std::thread thread_consumer ([&] { consume (c, sum); });
+
+        for (auto i : std::views::iota (0, num_producers))
+            scheduler.spawn (produce, c, i * num_values, auto (num_values));
+
+        while (scheduler.stats().finished < num_producers)
+            std::this_thread::yield();
+
+        // Consumers drain any remaining values before returning
+        {
+            std::scoped_lock _ (c.mutex);
+            c.closed = true;
+        }
+
+        c.condition.notify_all();
+        thread_consumer.join();
+    }
+
+    [[maybe_unused]] const long long n = num_producers * num_values;
+    [[maybe_unused]] const auto total = apply ([] (long long s) { return s; }, sum);
+    assert(total == n * (n - 1) / 2);
+}
+
+int main()
+{
+    assert(! scl::this_fiber::is_fiber());
+    test_many_fibers();
+    test_condition_variable();
+
+    return 0;
+}
+
+#else
+
+int main()
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "sync_send.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace scl {
+
+//================================================================================
+// Immutable Trait: Has no state that can change through a const reference
+//================================================================================
+// This means no mutable members, pointers or references as these could be
+// used to modify data (or be aliased elsewhere) even when the object is const.
+//
+// Like send, without reflection we can only check the top level type so
+// class types are assumed to be immutable unless specialised below.
+template<typename T>
+struct is_immutable;
+
+template<typename T>
+inline constexpr bool is_immutable_v = is_immutable<T>::value;
+
+#if __has_include (<experimental/meta>)
+
+consteval auto is_immutable_type (std::meta::info type) -> bool
+{
+    type = remove_cv (type);
+
+    // Pointers and references can be used to mutate the pointee
+    if (is_pointer_type (type)
+        || is_reference_type (type)
+        || is_member_pointer_type (type))
+       return false;
+
+    // POD built-in types
+    if (is_arithmetic_type (type) || is_enum_type (type))
+        return true;
+
+    if (is_array_type (type))
+        return is_immutable_type (remove_all_extents (type));
+
+    // Recursive class/struct members, using is_immutable so specialisations
+    // for library types (which use pointers internally) are respected
+    if (is_class_type (type))
+        return std::ranges::all_of(nonstatic_data_members_of(type),
+                                   [](std::meta::info d)
+                                   {
+                                       return ! is_mutable_member (d)
+                                           && extract<bool> (substitute (^^is_immutable_v, { type_of (d) }));
+                                   });
+
+    return false;
+}
+
+template<typename T>
+struct is_immutable : std::bool_constant<is_immutable_type (^^T)> {};
+
+#else
+
+template<typename T>
+struct is_immutable : std::bool_constant<! (std::is_reference_v<T>
+                                            || std::is_pointer_v<std::remove_all_extents_t<T>>
+                                            || std::is_member_pointer_v<std::remove_all_extents_t<T>>)
+                                         && (std::is_scalar_v<std::remove_all_extents_t<T>>
+                                             || std::is_class_v<std::remove_all_extents_t<T>>)>
+{};
+
+#endif //__has_include (<experimental/meta>)
+
+// Library types that are deeply immutable through a const reference
+template<typename CharT, typename Traits, typename Allocator>
+struct is_immutable<std::basic_string<CharT, Traits, Allocator>> : is_immutable<CharT> {};
+
+template<typename T, typename Allocator>
+struct is_immutable<std::vector<T, Allocator>> : is_immutable<T> {};
+
+template<typename T, std::size_t N>
+struct is_immutable<std::array<T, N>> : is_immutable<T> {};
+
+template<typename T>
+struct is_immutable<std::optional<T>> : is_immutable<T> {};
+
+template<typename T1, typename T2>
+struct is_immutable<std::pair<T1, T2>> : std::bool_constant<is_immutable_v<T1> && is_immutable_v<T2>> {};
+
+template<typename... Types>
+struct is_immutable<std::tuple<Types...>> : std::bool_constant<(is_immutable_v<Types> && ...)> {};
+
+// Views and smart pointers refer to data that can be modified elsewhere and
+// atomics are designed to be modified through a const reference
+template<typename CharT, typename Traits>
+struct is_immutable<std::basic_string_view<CharT, Traits>> : std::false_type {};
+
+template<typename T, typename Deleter>
+struct is_immutable<std::unique_ptr<T, Deleter>> : std::false_type {};
+
+template<typename T>
+struct is_immutable<std::shared_ptr<T>> : std::false_type {};
+
+template<typename T>
+struct is_immutable<std::atomic<T>> : std::false_type {};
+
+template<typename T>
+concept immutable = is_immutable_v<T>;
+
+
+//================================================================================
+//================================================================================
+/**
+ *  A deeply immutable value.
+ *
+ *  The value is constructed in place once and then only exposed as a const
+ *  reference. It can't be copied, moved or assigned to so there's no way to
+ *  modify it after construction. Because of this it's sync so can be read
+ *  from any number of threads with no locking.
+ *
+ *  Share it between threads by borrowing it in a scl::task_scope or with an
+ *  scl::arc<scl::frozen<T>>.
+ *
+ *  T must be immutable, i.e. have no mutable members or pointers. Without
+ *  reflection this can only be checked at the top level.
+ */
+template<immutable T>
+class frozen
+{
+public:
+    template<typename... Args>
+    explicit frozen (Args&&... args)
+        : value (std::forward<Args> (args)...)
+    {}
+
+    frozen (const frozen&) = delete;
+    frozen (frozen&&) = delete;
+    frozen& operator= (const frozen&) = delete;
+    frozen& operator= (frozen&&) = delete;
+
+    const T& get() const noexcept           { return value; }
+    const T& operator*() const noexcept     { return value; }
+    const T* operator->() const noexcept    { return &value; }
+
+private:
+    const T value;
+};
+
+template<typename T>
+struct is_immutable<frozen<T>> : std::true_type {};
+
+template<typename T>
+struct is_sync<frozen<T>> : std::true_type {};
+
+}
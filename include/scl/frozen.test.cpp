@@ -0,0 +1,104 @@
+#include <cassert>
+#include <memory>
+#include <ranges>
+#include <string>
+#include <vector>
+#include "arc.h"
+#include "frozen.h"
+#include "safe_thread.h"
+#include "task_scope.h"
+
+struct config
+{
+    std::string name;
+    std::vector<int> values;
+    int sample_rate = 44100;
+};
+
+static_assert(scl::is_immutable_v<int>);
+static_assert(scl::is_immutable_v<const int>);
+static_assert(scl::is_immutable_v<std::string>);
+static_assert(scl::is_immutable_v<std::vector<std::string>>);
+static_assert(scl::is_immutable_v<std::pair<int, std::string>>);
+static_assert(scl::is_immutable_v<config>);
+static_assert(! scl::is_immutable_v<int*>);
+static_assert(! scl::is_immutable_v<int&>);
+static_assert(! scl::is_immutable_v<const int*[4]>);
+static_assert(! scl::is_immutable_v<std::string_view>);
+static_assert(! scl::is_immutable_v<std::unique_ptr<int>>);
+static_assert(! scl::is_immutable_v<std::shared_ptr<const int>>);
+static_assert(! scl::is_immutable_v<std::vector<int*>>);
+static_assert(! scl::is_immutable_v<std::atomic<int>>);
+
+#if __has_include (<experimental/meta>)
+struct cached
+{
+    mutable int cache;
+};
+
+struct node
+{
+    int value;
+    node* next;
+};
+
+static_assert(! scl::is_immutable_v<cached>);
+static_assert(! scl::is_immutable_v<node>);
+#endif
+
+static_assert(scl::is_sync_v<scl::frozen<config>>);
+static_assert(scl::is_send_v<scl::arc<scl::frozen<config>>>);
+static_assert(! std::is_copy_constructible_v<scl::frozen<config>>);
+static_assert(! std::is_move_constructible_v<scl::frozen<config>>);
+static_assert(! std::is_assignable_v<scl::frozen<config>&, const scl::frozen<config>&>);
+static_assert(std::is_same_v<decltype(*std::declval<scl::frozen<config>&>()), const config&>);
+
+void sum_values (const scl::frozen<config>& c, std::atomic<int>& total)
+{
+    for (auto v : c->values)
+        total += v;
+}
+
+void test_borrow()
+{
+    const scl::frozen<config> c (config { "test", { 1, 2, 3 } });
+    std::atomic<int> total { 0 };
+
+    {
+        scl::task_scope scope;
+
+        for ([[maybe_unused]] auto i : std::views::iota (0, 4))
+            scope.spawn (sum_values, c, total);
+    }
+
+    assert(c->name == "test");
+    assert(total == 24);
+}
+
+std::atomic<int> num_matching_sample_rates { 0 };
+
+void check_sample_rate (scl::arc<scl::frozen<config>> c)
+{
+    if ((*c)->sample_rate == 48000)
+        ++num_matching_sample_rates;
+}
+
+void test_arc()
+{
+    auto c = scl::make_arc<scl::frozen<config>> (config { "arc", {}, 48000 });
+
+    {
+        std::vector<scl::thread> threads;
+
+        for ([[maybe_unused]] auto i : std::views::iota (0, 4))
+            threads.push_back (scl::thread (check_sample_rate, auto (c)));
+    }
+
+    assert(num_matching_sample_rates == 4);
+}
+
+int main()
+{
+    test_borrow();
+    test_arc();
+}
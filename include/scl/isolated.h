@@ -0,0 +1,135 @@
+#pragma once
+
+#include "sync_send.h"
+#include <cassert>
+#include <concepts>
+#include <functional>
+#include <memory>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+
+namespace scl {
+
+namespace detail {
+template<typename T>
+struct is_reference_wrapper : std::false_type {};
+
+template<typename T>
+struct is_reference_wrapper<std::reference_wrapper<T>> : std::true_type {};
+
+/** Types that refer to memory they don't own, which send can't see through. */
+template<typename R>
+concept reference_like = std::is_pointer_v<R>
+                      || is_reference_wrapper<R>::value
+                      || std::ranges::view<R>
+                      || std::ranges::borrowed_range<R>;
+}
+
+/** The result of a borrow: must be send and not a pointer, reference_wrapper,
+    view or borrowed range (e.g. std::span or std::string_view), so nothing
+    referring in to the isolated value can escape the borrow.
+*/
+template<typename R>
+concept borrow_result = std::is_void_v<R>
+                     || (send<R> && ! detail::reference_like<std::remove_cv_t<R>>);
+
+/** A T that isolated can own: a send value that doesn't itself refer to
+    memory it doesn't own, e.g. not a pointer, std::span or reference_wrapper.
+*/
+template<typename T>
+concept isolatable = std::is_object_v<T>
+                  && send<T>
+                  && ! detail::reference_like<std::remove_cv_t<T>>;
+
+/**
+    Uniquely owns a T so it can be moved between threads without copying.
+
+    Without reflection send can only check the top level of a type so a
+    large buffer would otherwise need to be deep-copied before being handed
+    to another thread to be sure it isn't still referenced. isolated<T>
+    instead guarantees exclusivity by construction:
+    - The T is either built in place from send arguments or moved in. A
+      moved-in T can still be aliased by pointers or iterators taken in to
+      its buffer before the move, so prefer building it in place
+    - The T is never exposed other than to a borrow function, whose result
+      has to be send and can't be a reference, pointer, view or span in to it
+    - Moving an isolated only moves a pointer, however big T is
+
+    N.B. The borrow function is trusted not to store the reference it's
+    given elsewhere, the same as any function passed a reference.
+*/
+template<isolatable T>
+class isolated
+{
+public:
+    /** Constructs the T in place from args. */
+    template<send... Args>
+        requires std::constructible_from<T, Args...>
+    explicit isolated (std::in_place_t, Args&&... args)
+        : value (std::make_unique<T> (std::forward<Args> (args)...))
+    {}
+
+    /** Takes ownership of a moved-in T. */
+    explicit isolated (T&& value_to_take)
+        : value (std::make_unique<T> (std::move (value_to_take)))
+    {}
+
+    /** An lvalue could still be aliased so must be moved in. */
+    isolated (T&) = delete;
+    isolated (const T&) = delete;
+
+    isolated (isolated&&) noexcept = default;
+    isolated& operator= (isolated&&) noexcept = default;
+
+    isolated (const isolated&) = delete;
+    isolated& operator= (const isolated&) = delete;
+
+    /** False once moved from or extracted. */
+    explicit operator bool() const noexcept
+    {
+        return value != nullptr;
+    }
+
+    /** Calls f with a reference to the T for the duration of the call. */
+    template<typename F>
+        requires std::invocable<F, T&> && borrow_result<std::invoke_result_t<F, T&>>
+    std::invoke_result_t<F, T&> borrow (F&& f)
+    {
+        assert (value);
+        return std::invoke (std::forward<F> (f), *value);
+    }
+
+    /** Calls f with a const reference to the T for the duration of the call. */
+    template<typename F>
+        requires std::invocable<F, const T&> && borrow_result<std::invoke_result_t<F, const T&>>
+    std::invoke_result_t<F, const T&> borrow (F&& f) const
+    {
+        assert (value);
+        return std::invoke (std::forward<F> (f), std::as_const (*value));
+    }
+
+    /** Moves the T out, leaving this empty. */
+    T extract() &&
+    {
+        assert (value);
+        auto taken = std::move (value);
+        return std::move (*taken);
+    }
+
+private:
+    std::unique_ptr<T> value;
+};
+
+/** Returns an isolated<T> constructed in place from args. */
+template<isolatable T, send... Args>
+    requires std::constructible_from<T, Args...>
+isolated<T> make_isolated (Args&&... args)
+{
+    return isolated<T> (std::in_place, std::forward<Args> (args)...);
+}
+
+template<isolatable T>
+struct is_send<isolated<T>> : std::true_type {};
+
+}
@@ -0,0 +1,85 @@
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "isolated.h"
+#include "safe_thread.h"
+
+using buffer = std::vector<std::uint8_t>;
+constexpr std::size_t buffer_size = 8 * 1024 * 1024;
+
+static_assert(scl::is_send_v<scl::isolated<buffer>>);
+static_assert(! std::is_copy_constructible_v<scl::isolated<buffer>>);
+static_assert(! std::is_constructible_v<scl::isolated<buffer>, buffer&>);
+static_assert(! std::is_constructible_v<scl::isolated<buffer>, std::in_place_t, int*>);
+
+// Types that refer to memory they don't own can't be isolated, or they'd be
+// send while what they refer to is still used
+static_assert(scl::isolatable<buffer>);
+static_assert(! scl::isolatable<int*>);
+static_assert(! scl::isolatable<std::span<int>>);
+static_assert(! scl::isolatable<std::reference_wrapper<int>>);
+static_assert(! scl::isolatable<std::string_view>);
+
+// Nothing that refers in to the value can be returned from a borrow
+static_assert(scl::borrow_result<void>);
+static_assert(scl::borrow_result<std::vector<int>>);
+static_assert(! scl::borrow_result<int*>);
+static_assert(! scl::borrow_result<std::reference_wrapper<int>>);
+static_assert(! scl::borrow_result<std::span<int>>);
+static_assert(! scl::borrow_result<std::string_view>);
+static_assert(! scl::borrow_result<std::ranges::ref_view<std::vector<int>>>);
+
+void test_single_thread()
+{
+    auto s = scl::isolated<std::string> (std::string ("isolated"));
+    assert(s);
+
+    [[maybe_unused]] auto size = s.borrow ([] (const std::string& v) { return v.size(); });
+    assert(size == 8);
+
+    s.borrow ([] (std::string& v) { v += " value"; });
+
+    auto moved = std::move (s);
+    assert(! s);
+    assert(moved);
+
+    [[maybe_unused]] auto value = std::move (moved).extract();
+    assert(value == "isolated value");
+    assert(! moved);
+}
+
+void fill_and_check (scl::isolated<buffer> b, [[maybe_unused]] std::uintptr_t expected_address)
+{
+    b.borrow ([&] (buffer& v)
+              {
+                  // The same allocation, not a copy
+                  assert(reinterpret_cast<std::uintptr_t> (v.data()) == expected_address);
+                  std::iota (v.begin(), v.end(), std::uint8_t (0));
+              });
+
+    [[maybe_unused]] const auto total = b.borrow ([] (const buffer& v) { return std::accumulate (v.begin(), v.end(), std::uint64_t (0)); });
+    assert(total == (buffer_size / 256) * (255 * 256 / 2));
+}
+
+void test_move_between_threads()
+{
+    auto b = scl::make_isolated<buffer> (auto (buffer_size));
+    const auto address = b.borrow ([] (buffer& v) { return reinterpret_cast<std::uintptr_t> (v.data()); });
+
+    scl::thread t (fill_and_check, std::move (b), auto (address));
+    assert(! b);
+}
+
+int main()
+{
+    test_single_thread();
+    test_move_between_threads();
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <chrono>
+#include <memory>
+#include <print>
+#include <ranges>
+#include <thread>
+#include <vector>
+#include "object_pool.h"
+
+struct buffer
+{
+    float samples[64];
+};
+
+constexpr std::size_t batch_size = 1'000;
+constexpr std::size_t num_batches = 2'000;
+
+template<typename Fn>
+double time_ms (Fn&& fn)
+{
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now() - start).count();
+}
+
+// Allocates a batch on this thread and frees it on another, like passing
+// buffers from a producer to a consumer thread
+template<typename Batch, typename MakeFn>
+double cross_thread (MakeFn&& make)
+{
+    return time_ms ([&]
+                    {
+                        for ([[maybe_unused]] auto i : std::views::iota (0uz, num_batches))
+                        {
+                            Batch batch;
+                            batch.reserve (batch_size);
+
+                            for ([[maybe_unused]] auto j : std::views::iota (0uz, batch_size))
+                                batch.push_back (make());
+
+                            std::thread ([b = std::move (batch)] () mutable { b.clear(); }).join();
+                        }
+                    });
+}
+
+template<typename MakeFn>
+double same_thread (MakeFn&& make)
+{
+    return time_ms ([&]
+                    {
+                        for ([[maybe_unused]] auto i : std::views::iota (0uz, num_batches * batch_size))
+                        {
+                            [[maybe_unused]] volatile auto p = make().get();
+                        }
+                    });
+}
+
+int main()
+{
+    scl::object_pool<buffer> pool;
+
+    const auto malloc_same = same_thread ([] { return std::make_unique<buffer>(); });
+    const auto pool_same = same_thread ([&] { return pool.make(); });
+
+    const auto malloc_cross = cross_thread<std::vector<std::unique_ptr<buffer>>> ([] { return std::make_unique<buffer>(); });
+    const auto pool_cross = cross_thread<std::vector<scl::object_pool<buffer>::handle>> ([&] { return pool.make(); });
+
+    std::println ("{} objects of {} bytes", num_batches * batch_size, sizeof (buffer));
+    std::println ("same thread   malloc: {:8.2f} ms   object_pool: {:8.2f} ms", malloc_same, pool_same);
+    std::println ("cross thread  malloc: {:8.2f} ms   object_pool: {:8.2f} ms", malloc_cross, pool_cross);
+
+    const auto stats = pool.stats();
+    std::println ("allocations: {}, local frees: {}, remote frees: {}, reclaimed batches: {}, slabs: {}",
+                  stats.allocations, stats.local_frees, stats.remote_frees, stats.reclaimed_batches, stats.slabs);
+}
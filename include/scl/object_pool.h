@@ -0,0 +1,358 @@
+#pragma once
+
+#include "sync_send.h"
+#include "utils/cache_line.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace scl {
+
+namespace detail {
+struct object_pool_cache
+{
+    std::uint64_t instance = 0;
+    void* heap = nullptr;
+};
+
+inline object_pool_cache& this_thread_object_pool_cache()
+{
+    thread_local object_pool_cache cache;
+    return cache;
+}
+
+/** Shared with the heaps a thread owns so they can see when it has exited
+    without the thread having to outlive, or know about, every pool.
+*/
+struct object_pool_thread
+{
+    std::atomic<bool> exited { false };
+};
+
+inline const std::shared_ptr<object_pool_thread>& this_object_pool_thread()
+{
+    struct holder
+    {
+        std::shared_ptr<object_pool_thread> thread = std::make_shared<object_pool_thread>();
+
+        ~holder()
+        {
+            // release: the next owner of this thread's heaps must see its writes to them
+            thread->exited.store (true, std::memory_order_release);
+        }
+    };
+
+    thread_local holder h;
+    return h.thread;
+}
+
+inline std::uint64_t next_object_pool_instance()
+{
+    static std::atomic<std::uint64_t> next { 1 };
+    return next.fetch_add (1, std::memory_order_relaxed);
+}
+}
+
+/**
+ *  A pool of T objects designed for objects that are created on one thread and
+ *  destroyed on another.
+ *
+ *  Every thread that creates objects gets its own heap with a free list that
+ *  only it touches, so creating and destroying objects on the same thread
+ *  doesn't need any synchronisation.
+ *
+ *  Objects destroyed on a different thread are pushed on to their heap's
+ *  lock-free "remote free" list. When the owning thread runs out of local
+ *  objects it takes the whole remote list in one go and reuses it. This
+ *  avoids contending with other threads on every allocation and keeps memory
+ *  with the thread that allocated it.
+ *
+ *  When a thread exits its heap is adopted by the next thread that needs one,
+ *  along with anything still on its remote free list, so the number of heaps
+ *  is bounded by the number of threads using the pool at once rather than
+ *  growing with every short-lived thread.
+ *
+ *  The pool is sync and its handles are send so they can be passed to
+ *  scl::thread. The pool must outlive all of its handles.
+ *  Memory is only returned to the system when the pool is destroyed.
+ */
+template<send T>
+class object_pool
+{
+    struct heap;
+
+    struct node
+    {
+        T* value() noexcept { return std::launder (reinterpret_cast<T*> (storage)); }
+
+        heap* owner = nullptr;
+        node* next = nullptr;
+        alignas (T) std::byte storage[sizeof (T)];
+    };
+
+public:
+    //==========================================
+    /** Uniquely owns an object in the pool, returning it when destroyed. */
+    class handle
+    {
+    public:
+        handle() = default;
+
+        handle (handle&& other) noexcept
+            : n (std::exchange (other.n, nullptr))
+        {}
+
+        handle& operator= (handle&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                n = std::exchange (other.n, nullptr);
+            }
+
+            return *this;
+        }
+
+        ~handle()
+        {
+            reset();
+        }
+
+        /** Destroys the object and returns it to the pool. */
+        void reset()
+        {
+            if (n)
+                release (std::exchange (n, nullptr));
+        }
+
+        T& operator*() const                { return *n->value(); }
+        T* operator->() const               { return n->value(); }
+        T* get() const                      { return n ? n->value() : nullptr; }
+        explicit operator bool() const      { return n != nullptr; }
+
+    private:
+        friend object_pool;
+
+        explicit handle (node* node_to_use)
+            : n (node_to_use)
+        {}
+
+        node* n = nullptr;
+    };
+
+    //==========================================
+    struct statistics
+    {
+        std::size_t allocations = 0;        // Objects created
+        std::size_t local_frees = 0;        // Objects destroyed on their owning thread
+        std::size_t remote_frees = 0;       // Objects destroyed on a different thread
+        std::size_t reclaimed_batches = 0;  // Number of times an owner took its remote free list
+        std::size_t slabs = 0;              // Number of slabs allocated from the system
+        std::size_t heaps = 0;              // Number of heaps, at most the number of threads creating objects at once
+    };
+
+    //==========================================
+    /** Creates a pool that allocates slab_size objects at a time. */
+    explicit object_pool (std::size_t slab_size_to_use = 64)
+        : slab_size (slab_size_to_use > 0 ? slab_size_to_use : 1)
+    {}
+
+    object_pool (const object_pool&) = delete;
+    object_pool& operator= (const object_pool&) = delete;
+
+    ~object_pool()
+    {
+        for (auto h = heaps.load (std::memory_order_acquire); h;)
+            delete std::exchange (h, h->next_heap);
+    }
+
+    /** Creates an object in the calling thread's heap. */
+    template<typename... Args>
+    handle make (Args&&... args)
+    {
+        auto& h = this_thread_heap();
+
+        if (! h.local_free)
+        {
+            // acquire: synchronises with the remote frees
+            h.local_free = h.remote_free.exchange (nullptr, std::memory_order_acquire);
+
+            if (h.local_free)
+                increment (h.reclaimed_batches);
+            else
+                add_slab (h);
+        }
+
+        auto n = std::exchange (h.local_free, h.local_free->next);
+
+        try
+        {
+            ::new (static_cast<void*> (n->storage)) T (std::forward<Args> (args)...);
+        }
+        catch (...)
+        {
+            n->next = std::exchange (h.local_free, n);
+            throw;
+        }
+
+        increment (h.allocations);
+        return handle (n);
+    }
+
+    /** Returns the totals for all the heaps.
+        These are only exact once all threads using the pool are idle.
+    */
+    statistics stats() const
+    {
+        statistics s;
+
+        for (auto h = heaps.load (std::memory_order_acquire); h; h = h->next_heap)
+        {
+            s.allocations       += h->allocations.load (std::memory_order_relaxed);
+            s.local_frees       += h->local_frees.load (std::memory_order_relaxed);
+            s.remote_frees      += h->remote_frees.load (std::memory_order_relaxed);
+            s.reclaimed_batches += h->reclaimed_batches.load (std::memory_order_relaxed);
+            s.slabs             += h->slabs.load (std::memory_order_relaxed);
+            ++s.heaps;
+        }
+
+        return s;
+    }
+
+private:
+    //==========================================
+    struct alignas (cache_line_size) heap
+    {
+        explicit heap (std::shared_ptr<detail::object_pool_thread> thread)
+            : owner (thread.get()), owner_ref (std::move (thread))
+        {}
+
+        // Only changed when adopting the heap of an exited thread. owner_ref
+        // keeps the owner alive so its address can't be reused by another thread
+        std::atomic<detail::object_pool_thread*> owner;
+        std::shared_ptr<detail::object_pool_thread> owner_ref;
+        heap* next_heap = nullptr;
+
+        // Owner thread only. The counters are atomic so stats() can read them
+        node* local_free = nullptr;
+        std::vector<std::unique_ptr<node[]>> slab_storage;
+        std::atomic<std::size_t> allocations { 0 }, local_frees { 0 }, reclaimed_batches { 0 }, slabs { 0 };
+
+        // Written by other threads so kept on a separate cache line
+        alignas (cache_line_size) std::atomic<node*> remote_free { nullptr };
+        std::atomic<std::size_t> remote_frees { 0 };
+    };
+
+    const std::size_t slab_size;
+    const std::uint64_t instance = detail::next_object_pool_instance();
+    std::atomic<heap*> heaps { nullptr };
+    std::mutex adoption_mutex;
+
+    /** Counters with a single writer don't need an atomic RMW. */
+    static void increment (std::atomic<std::size_t>& counter)
+    {
+        counter.store (counter.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void add_slab (heap& h)
+    {
+        auto& slab = h.slab_storage.emplace_back (std::make_unique<node[]> (slab_size));
+
+        for (std::size_t i = 0; i < slab_size; ++i)
+        {
+            slab[i].owner = &h;
+            slab[i].next = i + 1 < slab_size ? &slab[i + 1] : h.local_free;
+        }
+
+        h.local_free = &slab[0];
+        increment (h.slabs);
+    }
+
+    heap& this_thread_heap()
+    {
+        auto& cache = detail::this_thread_object_pool_cache();
+
+        if (cache.instance == instance)
+            return *static_cast<heap*> (cache.heap);
+
+        auto h = find_or_create_heap();
+        cache = { instance, h };
+        return *h;
+    }
+
+    heap* find_or_create_heap()
+    {
+        const auto& this_thread = detail::this_object_pool_thread();
+
+        // acquire: see the contents of heaps pushed by other threads
+        for (auto h = heaps.load (std::memory_order_acquire); h; h = h->next_heap)
+            if (h->owner.load (std::memory_order_relaxed) == this_thread.get())
+                return h;
+
+        if (auto h = adopt_orphaned_heap (this_thread))
+            return h;
+
+        // Only this thread can add a heap for itself so no need to check again
+        auto h = new heap (this_thread);
+        h->next_heap = heaps.load (std::memory_order_relaxed);
+
+        // release: publish the new heap's contents
+        while (! heaps.compare_exchange_weak (h->next_heap, h, std::memory_order_release, std::memory_order_relaxed))
+        {}
+
+        return h;
+    }
+
+    /** Takes over the heap of a thread that has exited, if there is one.
+        Serialised so only one thread can take each heap and an exited owner
+        isn't freed while another thread is checking it.
+    */
+    heap* adopt_orphaned_heap (const std::shared_ptr<detail::object_pool_thread>& this_thread)
+    {
+        std::scoped_lock _ (adoption_mutex);
+
+        for (auto h = heaps.load (std::memory_order_acquire); h; h = h->next_heap)
+        {
+            // acquire: see everything the exited thread wrote to the heap
+            if (h->owner_ref->exited.load (std::memory_order_acquire))
+            {
+                h->owner.store (this_thread.get(), std::memory_order_relaxed);
+                h->owner_ref = this_thread;
+                return h;
+            }
+        }
+
+        return nullptr;
+    }
+
+    static void release (node* n)
+    {
+        auto& h = *n->owner;
+        n->value()->~T();
+
+        if (h.owner.load (std::memory_order_relaxed) == detail::this_object_pool_thread().get())
+        {
+            n->next = std::exchange (h.local_free, n);
+            increment (h.local_frees);
+            return;
+        }
+
+        // release: the owner must see the node's next pointer when it takes the list
+        n->next = h.remote_free.load (std::memory_order_relaxed);
+
+        while (! h.remote_free.compare_exchange_weak (n->next, n, std::memory_order_release, std::memory_order_relaxed))
+        {}
+
+        h.remote_frees.fetch_add (1, std::memory_order_relaxed);
+    }
+};
+
+template<typename T>
+struct is_sync<object_pool<T>> : std::true_type {};
+
+}
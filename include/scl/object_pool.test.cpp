@@ -0,0 +1,135 @@
+#include <cassert>
+#include <ranges>
+#include <string>
+#include <thread>
+#include <vector>
+#include "object_pool.h"
+#include "safe_thread.h"
+
+using string_pool = scl::object_pool<std::string>;
+
+static_assert(scl::is_sync_v<string_pool>);
+static_assert(scl::is_send_v<string_pool::handle>);
+static_assert(! std::is_copy_constructible_v<string_pool::handle>);
+
+void test_single_thread()
+{
+    string_pool pool (4);
+
+    auto a = pool.make ("a");
+    [[maybe_unused]] const auto a_address = a.get();
+    assert(*a == "a");
+
+    // Freed objects are reused by the same thread
+    a.reset();
+    auto b = pool.make (10, 'b');
+    assert(b.get() == a_address);
+    assert(*b == "bbbbbbbbbb");
+
+    std::vector<string_pool::handle> handles;
+
+    for (auto i : std::views::iota (0, 8))
+        handles.push_back (pool.make (std::to_string (i)));
+
+    assert(*handles.back() == "7");
+    handles.clear();
+
+    [[maybe_unused]] const auto stats = pool.stats();
+    assert(stats.allocations == 10);
+    assert(stats.local_frees == 9);
+    assert(stats.remote_frees == 0);
+    assert(stats.slabs == 3);
+    assert(stats.heaps == 1);
+}
+
+void consume (string_pool::handle h)
+{
+    h->append ("!");
+}
+
+void test_remote_free()
+{
+    string_pool pool (16);
+
+    {
+        std::vector<scl::thread> threads;
+
+        for (auto i : std::views::iota (0, 16))
+            threads.push_back (scl::thread (consume, pool.make (std::to_string (i))));
+    }
+
+    [[maybe_unused]] auto s = pool.stats();
+    assert(s.remote_frees == 16);
+    assert(s.slabs == 1);
+
+    // The next allocation takes back the remote frees in one batch
+    // rather than allocating a new slab
+    auto h = pool.make();
+    s = pool.stats();
+    assert(s.reclaimed_batches == 1);
+    assert(s.slabs == 1);
+}
+
+void produce (string_pool& pool, std::vector<string_pool::handle>& out, int n)
+{
+    for (auto i : std::views::iota (0, n))
+        out.push_back (pool.make (std::to_string (i)));
+}
+
+void test_many_producers()
+{
+    string_pool pool;
+    std::vector<std::vector<string_pool::handle>> outputs (4);
+
+    for ([[maybe_unused]] auto round : std::views::iota (0, 3))
+    {
+        // Each thread is the owner of its own heap...
+        std::vector<std::thread> threads;
+
+        for (auto& out : outputs)
+            threads.emplace_back (produce, std::ref (pool), std::ref (out), 1'000);
+
+        for (auto& t : threads)
+            t.join();
+
+        // ...and everything is freed remotely here
+        for (auto& out : outputs)
+            out.clear();
+    }
+
+    [[maybe_unused]] const auto stats = pool.stats();
+    assert(stats.allocations == 12'000);
+    assert(stats.remote_frees == 12'000);
+
+    // Heaps of exited threads are adopted rather than a new one created for
+    // every thread, so there are never more than were running at once
+    assert(stats.heaps <= 4);
+}
+
+void test_exited_thread_heap_is_adopted()
+{
+    string_pool pool (16);
+    std::vector<string_pool::handle> out;
+
+    for ([[maybe_unused]] auto round : std::views::iota (0, 3))
+    {
+        std::thread producer (produce, std::ref (pool), std::ref (out), 16);
+        producer.join();
+        out.clear();
+    }
+
+    // Each producer takes over the last one's heap along with the objects
+    // freed to it after it exited
+    [[maybe_unused]] const auto stats = pool.stats();
+    assert(stats.heaps == 1);
+    assert(stats.slabs == 1);
+    assert(stats.reclaimed_batches == 2);
+}
+
+int main()
+{
+    test_single_thread();
+    test_remote_free();
+    test_many_producers();
+    test_exited_thread_heap_is_adopted();
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "sync_send.h"
+#include "utils/cache_line.h"
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+namespace scl {
+
+namespace detail {
+struct per_thread_cache
+{
+    std::uint64_t instance = 0;
+    void* slot = nullptr;
+};
+
+inline per_thread_cache& this_thread_per_thread_cache()
+{
+    thread_local per_thread_cache cache;
+    return cache;
+}
+
+inline std::uint64_t next_per_thread_instance()
+{
+    static std::atomic<std::uint64_t> next { 1 };
+    return next.fetch_add (1, std::memory_order_relaxed);
+}
+}
+
+/**
+ *  A value with a separate instance for every thread that uses it, similar
+ *  to an enumerable thread_local.
+ *
+ *  Each thread's instance is created the first time it calls local() by
+ *  copying the initial value. Instances are aligned to a cache line so
+ *  threads updating their own instance don't contend with each other.
+ *  Finding a thread's instance is lock-free and the most recently used one
+ *  is cached per thread.
+ *
+ *  Calling local() is sync, so a per_thread can be shared between threads by
+ *  reference (e.g. borrowed in a scl::task_scope). Once the threads have been
+ *  joined, for_each and combine can be used to visit or reduce all the
+ *  instances.
+ *
+ *  @code
+ *  scl::per_thread<int> hits;
+ *  {
+ *      scl::task_scope scope;
+ *      for (auto i : std::views::iota (0, 8))
+ *          scope.spawn (count_hits, hits, auto (i)); // ++hits.local()
+ *  }
+ *  auto total = hits.combine (std::plus());
+ *  @endcode
+ */
+template<send T>
+class per_thread
+{
+public:
+    /** Each thread's instance will be a copy of initial_value. */
+    explicit per_thread (T initial_value = T())
+        : initial (std::move (initial_value))
+    {}
+
+    per_thread (const per_thread&) = delete;
+    per_thread& operator= (const per_thread&) = delete;
+
+    ~per_thread()
+    {
+        for (auto s = head.load (std::memory_order_acquire); s;)
+            delete std::exchange (s, s->next);
+    }
+
+    /** Returns the calling thread's instance, creating it if needed. */
+    T& local()
+    {
+        auto& cache = detail::this_thread_per_thread_cache();
+
+        if (cache.instance == instance)
+            return static_cast<slot*> (cache.slot)->value;
+
+        auto s = find_or_create();
+        cache = { instance, s };
+        return s->value;
+    }
+
+    /** Calls f with each thread's instance.
+        This must not be called while other threads can be calling local().
+    */
+    template<typename F>
+    void for_each (F&& f)
+    {
+        for (auto s = head.load (std::memory_order_acquire); s; s = s->next)
+            f (s->value);
+    }
+
+    template<typename F>
+    void for_each (F&& f) const
+    {
+        for (auto s = head.load (std::memory_order_acquire); s; s = s->next)
+            f (std::as_const (s->value));
+    }
+
+    /** Reduces all of the instances using op, starting with the initial value
+        so this should be the identity of op.
+        This must not be called while other threads can be calling local().
+    */
+    template<typename BinaryOp>
+    T combine (BinaryOp&& op) const
+    {
+        auto result = initial;
+        for_each ([&] (const T& v) { result = op (std::move (result), v); });
+        return result;
+    }
+
+    /** Returns the number of threads that have created an instance. */
+    std::size_t size() const
+    {
+        std::size_t num = 0;
+        for_each ([&] (const T&) { ++num; });
+        return num;
+    }
+
+private:
+    struct alignas (cache_line_size) slot
+    {
+        slot (const T& v, std::thread::id id)
+            : value (v), owner (id)
+        {}
+
+        T value;
+        const std::thread::id owner;
+        slot* next = nullptr;
+    };
+
+    const T initial;
+    const std::uint64_t instance = detail::next_per_thread_instance();
+    std::atomic<slot*> head { nullptr };
+
+    slot* find_or_create()
+    {
+        const auto this_thread_id = std::this_thread::get_id();
+
+        // acquire: see the contents of slots pushed by other threads
+        for (auto s = head.load (std::memory_order_acquire); s; s = s->next)
+            if (s->owner == this_thread_id)
+                return s;
+
+        // Only this thread can add a slot for itself so no need to check again
+        auto s = new slot (initial, this_thread_id);
+        s->next = head.load (std::memory_order_relaxed);
+
+        // release: publish the new slot's contents
+        while (! head.compare_exchange_weak (s->next, s, std::memory_order_release, std::memory_order_relaxed))
+        {}
+
+        return s;
+    }
+};
+
+template<typename T>
+struct is_sync<per_thread<T>> : std::true_type {};
+
+}
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <ranges>
+#include <string>
+#include <vector>
+#include "per_thread.h"
+#include "task_scope.h"
+
+static_assert(scl::is_sync_v<scl::per_thread<int>>);
+static_assert(scl::sync_reference<scl::per_thread<std::vector<int>>&>);
+
+void count_to (scl::per_thread<std::int64_t>& counts, int n)
+{
+    for (auto i : std::views::iota (0, n))
+        counts.local() += i;
+}
+
+void test_combine()
+{
+    scl::per_thread<std::int64_t> counts;
+
+    {
+        scl::task_scope scope;
+
+        for ([[maybe_unused]] auto i : std::views::iota (0, 8))
+            scope.spawn (count_to, counts, 100'000);
+    }
+
+    assert(counts.size() <= 8);
+    assert(counts.combine (std::plus()) == 8 * (99'999ll * 100'000ll / 2));
+
+    counts.for_each ([] ([[maybe_unused]] auto& c)
+                     {
+                         // Each instance is on its own cache line
+                         assert(reinterpret_cast<std::uintptr_t> (&c) % scl::cache_line_size == 0);
+                     });
+}
+
+void collect (scl::per_thread<std::vector<int>>& values, int v)
+{
+    values.local().push_back (v);
+}
+
+void test_initial_value()
+{
+    scl::per_thread<std::vector<int>> values ({ -1 });
+
+    {
+        scl::task_scope scope;
+
+        for (auto i : std::views::iota (0, 4))
+            scope.spawn (collect, values, auto (i));
+    }
+
+    // The initial value is copied in to every thread's instance
+    values.for_each ([] ([[maybe_unused]] auto& v) { assert(v.front() == -1); });
+
+    const auto all = values.combine ([] (auto a, const auto& b)
+                                     {
+                                         a.insert (a.end(), b.begin(), b.end());
+                                         return a;
+                                     });
+    assert(std::ranges::count (all, -1) == static_cast<long> (values.size() + 1));
+    assert(all.size() == values.size() + 5);
+}
+
+void test_local()
+{
+    scl::per_thread<std::string> s ("a");
+    s.local() += "b";
+
+    // Interleaving instances misses the cache but finds the same value
+    scl::per_thread<std::string> other;
+    other.local() += "c";
+
+    s.local() += "c";
+    assert(s.local() == "abc");
+    assert(other.local() == "c");
+    assert(s.size() == 1);
+}
+
+int main()
+{
+    test_combine();
+    test_initial_value();
+    test_local();
+}
@@ -5,10 +5,16 @@
 #pragma once
 
 #include "sync_send.h"
+#include "thread_accounting.h"
+#include "utils/happens_before.h"
+#include <functional>
+#include <memory>
 #include <thread>
 #include <utility>
 
 namespace scl {
+class task_scope;
+
 /**
  *  A thread whose invokable and argumnets are checked to ensure they conform
  *  to the send concept.
@@ -24,15 +30,30 @@ class thread
 public:
     template<typename F, send... Args>
     thread (F&& f, Args&&... args)
-        : thread_internal (std::forward<F> (f), std::forward<Args> (args)...)
+        : clocks (detail::fork()),
+          thread_internal (start (nullptr, clocks, std::forward<F> (f), std::forward<Args> (args)...))
     {
         // N.B. We can't constrain F to the concept due to recursion of is_move_constructable
         // So we have to statically assert it
         static_assert (send<F>);
     }
 
+    /** Creates a thread that records its resource usage, see usage() and
+        thread_registry.
+    */
+    template<typename F, send... Args>
+    thread (thread_accounting accounting, F&& f, Args&&... args)
+        : record (std::make_shared<detail::thread_record> (std::move (accounting.name))),
+          clocks (detail::fork()),
+          thread_internal (start (record, clocks, std::forward<F> (f), std::forward<Args> (args)...))
+    {
+        static_assert (send<F>);
+    }
+
     thread (thread&& other)
-        : thread (std::move (other.thread_internal))
+        : record (std::move (other.record)),
+          clocks (std::move (other.clocks)),
+          thread_internal (std::move (other.thread_internal))
     {
     }
 
@@ -45,9 +66,80 @@ public:
     void join()
     {
         thread_internal.join();
+
+        if (clocks)
+            clocks->end.acquire();
+    }
+
+    /** Returns the resources used by the thread so far, or in total once it
+        has finished. Empty if the thread wasn't created with thread_accounting.
+    */
+    std::optional<thread_usage> usage() const
+    {
+        if (! record)
+            return std::nullopt;
+
+        return thread_registry::usage (*record);
     }
 
 private:
+    friend task_scope;
+
+    std::shared_ptr<detail::thread_record> record;
+    std::shared_ptr<detail::fork_clocks> clocks;
     std::thread thread_internal;
+
+    thread (std::shared_ptr<detail::thread_record> r, std::shared_ptr<detail::fork_clocks> c, std::thread t)
+        : record (std::move (r)),
+          clocks (std::move (c)),
+          thread_internal (std::move (t))
+    {
+    }
+
+    /** Used by task_scope, which checks its own arguments as they can also be
+        borrows of sync objects. r is null if the thread isn't accounted.
+    */
+    template<typename F, typename... Args>
+    static thread borrowing (std::shared_ptr<detail::thread_record> r, F&& f, Args&&... args)
+    {
+        static_assert (send<F>);
+
+        auto c = detail::fork();
+        auto t = start (r, c, std::forward<F> (f), std::forward<Args> (args)...);
+        return thread (std::move (r), std::move (c), std::move (t));
+    }
+
+    /** Only wraps f if there's accounting or clocks to pass. */
+    template<typename F, typename... Args>
+    static std::thread start (std::shared_ptr<detail::thread_record> r, std::shared_ptr<detail::fork_clocks> c,
+                              F&& f, Args&&... args)
+    {
+        if (! r && ! c)
+            return std::thread (std::forward<F> (f), std::forward<Args> (args)...);
+
+        return std::thread (&run_wrapped<std::decay_t<F>, std::decay_t<Args>...>,
+                            std::move (r), std::move (c), std::forward<F> (f), std::forward<Args> (args)...);
+    }
+
+    template<typename F, typename... Args>
+    static void run_wrapped (std::shared_ptr<detail::thread_record> r, std::shared_ptr<detail::fork_clocks> c,
+                             F&& f, Args&&... args)
+    {
+        struct scoped_record
+        {
+            detail::thread_record* r;
+
+            scoped_record (detail::thread_record* r_) : r (r_)  { if (r) thread_registry::thread_started (*r); }
+            ~scoped_record()                                    { if (r) thread_registry::thread_finished (*r); }
+        } _ (r.get());
+
+        if (c)
+            c->start.acquire();
+
+        std::invoke (std::forward<F> (f), std::forward<Args> (args)...);
+
+        if (c)
+            c->end.release();
+    }
 };
 }
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "sync_send.h"
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <utility>
+
+namespace scl {
+
+template<typename Signature, std::size_t Capacity = 64>
+class send_function;
+
+/** A callable F that send_function can store inline in Capacity bytes:
+    not over-aligned and nothrow movable so moving the function can't throw.
+*/
+template<typename F, std::size_t Capacity>
+concept fits_send_function = sizeof (F) <= Capacity
+                          && alignof (F) <= alignof (std::max_align_t)
+                          && std::is_nothrow_move_constructible_v<F>;
+
+/**
+ *  A move-only, type-erased callable similar to std::move_only_function but
+ *  that only accepts callables that conform to the send concept.
+ *
+ *  The callable is always stored inline so constructing one never allocates.
+ *  Callables larger than Capacity bytes are rejected at compile time, as
+ *  the constructor is constrained so is_constructible_v and concepts see it.
+ *
+ *  This makes it suitable for queuing tasks to be run on other threads as the
+ *  same checks scl::thread makes on its invokable are made here.
+ */
+template<typename R, typename... Args, std::size_t Capacity>
+class send_function<R (Args...), Capacity>
+{
+public:
+    send_function() = default;
+
+    send_function (std::nullptr_t) noexcept
+    {
+    }
+
+    /** Only callables that are send, invocable with the signature and fit
+        inline without being over-aligned take part in overload resolution.
+    */
+    template<typename F>
+        requires (! std::is_same_v<std::remove_cvref_t<F>, send_function>)
+              && send<F>
+              && std::is_invocable_r_v<R, std::decay_t<F>&, Args...>
+              && fits_send_function<std::decay_t<F>, Capacity>
+    send_function (F&& f)
+    {
+        using callable = std::decay_t<F>;
+        ::new (static_cast<void*> (storage)) callable (std::forward<F> (f));
+        ops = &ops_for<callable>;
+    }
+
+    send_function (send_function&& other) noexcept
+    {
+        if (other.ops)
+        {
+            other.ops->move (storage, other.storage);
+            ops = std::exchange (other.ops, nullptr);
+        }
+    }
+
+    send_function& operator= (send_function&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+
+            if (other.ops)
+            {
+                other.ops->move (storage, other.storage);
+                ops = std::exchange (other.ops, nullptr);
+            }
+        }
+
+        return *this;
+    }
+
+    send_function& operator= (std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    ~send_function()
+    {
+        reset();
+    }
+
+    R operator() (Args... args)
+    {
+        return ops->invoke (storage, std::forward<Args> (args)...);
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return ops != nullptr;
+    }
+
+private:
+    struct operations
+    {
+        R (*invoke) (void*, Args&&...);
+        void (*move) (void* dest, void* source) noexcept;  // Move constructs and destroys source
+        void (*destroy) (void*) noexcept;
+    };
+
+    template<typename Callable>
+    static constexpr operations ops_for
+    {
+        [] (void* p, Args&&... args) -> R
+        {
+            return std::invoke (*static_cast<Callable*> (p), std::forward<Args> (args)...);
+        },
+        [] (void* dest, void* source) noexcept
+        {
+            auto& s = *static_cast<Callable*> (source);
+            ::new (dest) Callable (std::move (s));
+            s.~Callable();
+        },
+        [] (void* p) noexcept
+        {
+            static_cast<Callable*> (p)->~Callable();
+        }
+    };
+
+    alignas (std::max_align_t) std::byte storage[Capacity];
+    const operations* ops = nullptr;
+
+    void reset() noexcept
+    {
+        if (ops)
+            std::exchange (ops, nullptr)->destroy (storage);
+    }
+};
+
+// A send_function is callable so wouldn't be send by default but it can only
+// hold send callables
+template<typename Signature, std::size_t Capacity>
+struct is_send<send_function<Signature, Capacity>> : std::true_type {};
+
+}
@@ -0,0 +1,122 @@
+#include <cassert>
+#include <memory>
+#include <string>
+#include <vector>
+#include "safe_thread.h"
+#include "send_function.h"
+
+int add (int a, int b)
+{
+    return a + b;
+}
+
+struct accumulate
+{
+    int operator() (int v) { return total += v; }
+
+    int total = 0;
+};
+
+template<>
+struct scl::is_send<accumulate> : std::true_type {};
+
+struct counted_task
+{
+    counted_task()                      { ++num_alive; }
+    counted_task (counted_task&& o) noexcept
+        : value (std::move (o.value))   { ++num_alive; }
+    ~counted_task()                     { --num_alive; }
+
+    int operator()() { return *value; }
+
+    std::unique_ptr<int> value = std::make_unique<int> (42);
+    static inline int num_alive = 0;
+};
+
+template<>
+struct scl::is_send<counted_task> : std::true_type {};
+
+struct large_task
+{
+    void operator()() {}
+    char data[128];
+};
+
+template<>
+struct scl::is_send<large_task> : std::true_type {};
+
+static_assert(scl::is_send_v<scl::send_function<void()>>);
+static_assert(std::is_constructible_v<scl::send_function<int (int, int)>, decltype(&add)>);
+static_assert(! std::is_copy_constructible_v<scl::send_function<void()>>);
+static_assert(sizeof (scl::send_function<void(), 128>) > sizeof (large_task));
+
+// Callables that can't be stored don't take part in overload resolution
+static_assert(std::is_constructible_v<scl::send_function<void(), 128>, large_task>);
+static_assert(! std::is_constructible_v<scl::send_function<void(), 64>, large_task>);
+static_assert(! std::is_constructible_v<scl::send_function<void (int)>, large_task>);
+static_assert(! std::is_constructible_v<scl::send_function<void()>, large_task&>);
+static_assert(! std::is_convertible_v<int, scl::send_function<void()>>);
+
+void test_function_pointer()
+{
+    scl::send_function<int (int, int)> f (add);
+    assert(f);
+    assert(f (1, 2) == 3);
+
+    f = nullptr;
+    assert(! f);
+}
+
+void test_state()
+{
+    scl::send_function<int (int)> f (accumulate {});
+    f (1);
+    f (2);
+    assert(f (3) == 6);
+
+    auto g = std::move (f);
+    assert(! f);
+    assert(g (4) == 10);
+}
+
+void test_lifetime()
+{
+    {
+        scl::send_function<int()> f (counted_task {});
+        assert(counted_task::num_alive == 1);
+
+        std::vector<scl::send_function<int()>> tasks;
+        tasks.push_back (std::move (f));
+        tasks.emplace_back (counted_task {});
+        assert(counted_task::num_alive == 2);
+
+        [[maybe_unused]] int total = 0;
+
+        for (auto& t : tasks)
+            total += t();
+
+        assert(total == 84);
+    }
+
+    assert(counted_task::num_alive == 0);
+}
+
+void run (scl::send_function<int()> task)
+{
+    [[maybe_unused]] const auto result = task();
+    assert(result == 42);
+}
+
+void test_thread()
+{
+    scl::thread t (run, scl::send_function<int()> (counted_task {}));
+    t.join();
+}
+
+int main()
+{
+    test_function_pointer();
+    test_state();
+    test_lifetime();
+    test_thread();
+}
@@ -6,9 +6,23 @@
 #pragma once
 
 #include "sync_send.h"
+#include "utils/happens_before.h"
+#include "utils/lockset.h"
+#include <mutex>
 
 namespace scl {
-template<typename Type>
+class async_mutex;
+
+namespace detail {
+template<typename Sch, typename F, typename... Types>
+class async_apply_awaiter;
+}
+
+/**
+ *  Mutex can be any Lockable type, e.g. a scl::fiber_mutex so that fibers
+ *  accessing the value only block themselves rather than their thread.
+ */
+template<typename Type, typename Mutex = std::mutex>
 class synchronized_value
 {
 public:
@@ -22,26 +36,32 @@ public:
         : val (std::forward<Args> (args)...)
     {}
 
-    template<typename Fn, typename Up, typename... Types>
-    friend std::invoke_result_t<Fn, Up&, Types&...> apply (Fn&&, synchronized_value<Up>&,
-                                                           synchronized_value<Types>&...);
+    template<typename Fn, typename Up, typename UpMutex, typename... Types, typename... Mutexes>
+    friend std::invoke_result_t<Fn, Up&, Types&...> apply (Fn&&, synchronized_value<Up, UpMutex>&,
+                                                           synchronized_value<Types, Mutexes>&...);
+
+    template<typename Sch, typename F, typename... Types>
+    friend class detail::async_apply_awaiter;
 
 private:
-    std::mutex mutex;
+    Mutex mutex;
+    [[no_unique_address]] sync_clock clock;
     Type val;
 };
 
-template<typename _Fn, typename _Tp, typename... _Types>
-inline std::invoke_result_t<_Fn, _Tp &, _Types &...> apply(_Fn &&__f, synchronized_value<_Tp> &__val,
-                                                      synchronized_value<_Types> &...__vals) {
+template<typename _Fn, typename _Tp, typename _Mutex, typename... _Types, typename... _Mutexes>
+inline std::invoke_result_t<_Fn, _Tp &, _Types &...> apply(_Fn &&__f, synchronized_value<_Tp, _Mutex> &__val,
+                                                      synchronized_value<_Types, _Mutexes> &...__vals) {
     std::scoped_lock __l(__val.mutex, __vals.mutex...);
+    detail::scoped_sync_clocks __c(__val.clock, __vals.clock...);
+    detail::scoped_held_locks __h(__val.mutex, __vals.mutex...);
     return std::__invoke(std::forward<_Fn>(__f), __val.val, __vals.val...);
 }
 
-template<typename T>
-struct is_send<synchronized_value<T>&> : std::true_type {};
+template<typename T, typename Mutex>
+struct is_send<synchronized_value<T, Mutex>&> : std::true_type {};
 
-template<typename T>
-struct is_sync<synchronized_value<T>> : std::true_type {};
+template<typename T, typename Mutex>
+struct is_sync<synchronized_value<T, Mutex>> : std::true_type {};
 
 }
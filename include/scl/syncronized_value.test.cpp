@@ -19,9 +19,9 @@ void test_single() {
 
 void test_multi() {
     scl::synchronized_value<int> a(1), b(2), c(3);
-    int sum = apply([](auto &...ints) { return (ints++ + ...); }, a, b, c);
+    [[maybe_unused]] int sum = apply([](auto &...ints) { return (ints++ + ...); }, a, b, c);
     assert(sum == 6);
-    auto get = [](int &i) { return i; };
+    [[maybe_unused]] auto get = [](int &i) { return i; };
     assert(apply(get, a) == 2);
     assert(apply(get, b) == 3);
     assert(apply(get, c) == 4);
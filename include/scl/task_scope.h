@@ -0,0 +1,98 @@
+#pragma once
+
+#include "safe_thread.h"
+#include "sync_send.h"
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace scl {
+
+/** An lvalue reference to a sync object. These can be borrowed by threads
+    that are guaranteed to finish before the object goes out of scope.
+*/
+template<typename T>
+concept sync_reference = std::is_lvalue_reference_v<T>
+                         && is_sync_v<std::remove_cvref_t<T>>;
+
+/**
+ *  A structured concurrency scope (or "nursery").
+ *
+ *  Threads spawned in the scope are always joined before the scope is
+ *  destroyed. Because they can't outlive it, arguments can be references to
+ *  sync objects declared before the scope as well as send types. This avoids
+ *  having to wrap shared data in a std::shared_ptr just to share it.
+ *
+ *  As with scl::thread, the invokable itself must be send so can't capture
+ *  references, borrows must be passed as arguments. The threads are
+ *  scl::threads so joining the scope orders their accesses before the
+ *  caller's for the data race checker, and can be given a thread_accounting
+ *  to record their resource usage.
+ *
+ *  @code
+ *  scl::synchronized_value<std::string> s;
+ *  {
+ *      scl::task_scope scope;
+ *      scope.spawn (append, s, auto (i));
+ *  } // All threads joined here
+ *  @endcode
+ *
+ *  N.B. spawn and join should only be called from the thread that created the
+ *  scope and objects borrowed must be declared before it.
+ */
+class task_scope
+{
+public:
+    task_scope() = default;
+    task_scope (const task_scope&) = delete;
+    task_scope& operator= (const task_scope&) = delete;
+
+    ~task_scope()
+    {
+        join();
+    }
+
+    template<typename F, typename... Args>
+        requires ((send<Args> || sync_reference<Args>) && ...)
+    void spawn (F&& f, Args&&... args)
+    {
+        // N.B. We can't constrain F to the concept due to recursion of is_move_constructable
+        // So we have to statically assert it
+        static_assert (send<F>);
+
+        threads.push_back (thread::borrowing (nullptr, std::forward<F> (f), borrow (std::forward<Args> (args))...));
+    }
+
+    /** Spawns a thread that records its resource usage, see thread_registry. */
+    template<typename F, typename... Args>
+        requires ((send<Args> || sync_reference<Args>) && ...)
+    void spawn (thread_accounting accounting, F&& f, Args&&... args)
+    {
+        static_assert (send<F>);
+
+        threads.push_back (thread::borrowing (std::make_shared<detail::thread_record> (std::move (accounting.name)),
+                                              std::forward<F> (f), borrow (std::forward<Args> (args))...));
+    }
+
+    /** Waits for all the threads spawned so far to finish. */
+    void join()
+    {
+        // scl::thread joins on destruction
+        threads.clear();
+    }
+
+private:
+    std::vector<thread> threads;
+
+    template<typename T>
+    static decltype(auto) borrow (T&& arg)
+    {
+        if constexpr (sync_reference<T&&>)
+            return std::ref (arg);
+        else
+            return std::forward<T> (arg);
+    }
+};
+
+}
@@ -0,0 +1,84 @@
+#include <atomic>
+#include <cassert>
+#include <ranges>
+#include <string>
+#include "synchronized_value.h"
+#include "thread_accounting.h"
+#include "task_scope.h"
+
+static_assert(scl::sync_reference<std::atomic<int>&>);
+static_assert(scl::sync_reference<const std::atomic<int>&>);
+static_assert(scl::sync_reference<scl::synchronized_value<int>&>);
+static_assert(! scl::sync_reference<std::atomic<int>>);
+static_assert(! scl::sync_reference<int&>);
+static_assert(! scl::sync_reference<const std::string&>);
+
+void increment (std::atomic<int>& counter, int amount)
+{
+    counter += amount;
+}
+
+void append (scl::synchronized_value<std::string>& s, std::string suffix)
+{
+    apply ([&] (auto& str) { str.append (suffix); }, s);
+}
+
+void test_borrow_atomic()
+{
+    std::atomic<int> counter { 0 };
+
+    {
+        scl::task_scope scope;
+
+        for (auto i : std::views::iota (0, 8))
+            scope.spawn (increment, counter, auto (i));
+    }
+
+    assert(counter == 28);
+}
+
+void test_borrow_synchronized_value()
+{
+    scl::synchronized_value<std::string> s ("Hello");
+
+    {
+        scl::task_scope scope;
+
+        for ([[maybe_unused]] auto i : std::views::iota (0, 4))
+            scope.spawn (append, s, std::string ("!"));
+
+        // Can be joined early and reused
+        scope.join();
+        assert(apply ([] (auto& str) { return str; }, s) == "Hello!!!!");
+
+        scope.spawn (append, s, std::string ("?"));
+    }
+
+    assert(apply ([] (auto& str) { return str; }, s) == "Hello!!!!?");
+}
+
+void check_registered (std::atomic<int>& num_registered)
+{
+    for (auto& e : scl::thread_registry::snapshot())
+        if (e.name == "scoped")
+            ++num_registered;
+}
+
+void test_accounting()
+{
+    std::atomic<int> num_registered { 0 };
+
+    {
+        scl::task_scope scope;
+        scope.spawn (scl::thread_accounting { "scoped" }, check_registered, num_registered);
+    }
+
+    assert(num_registered == 1);
+}
+
+int main()
+{
+    test_borrow_atomic();
+    test_borrow_synchronized_value();
+    test_accounting();
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined (__linux__)
+ #include <fstream>
+ #include <pthread.h>
+ #include <sys/resource.h>
+ #include <unistd.h>
+#endif
+
+namespace scl {
+
+/** Resources used by a thread over its lifetime. */
+struct thread_usage
+{
+    std::chrono::nanoseconds wall_time { 0 };
+    std::chrono::nanoseconds cpu_time { 0 };
+    long voluntary_context_switches = 0;
+    long involuntary_context_switches = 0;
+};
+
+/** Passed as the first argument to scl::thread to opt in to recording its
+    thread_usage and listing it in the thread_registry whilst it runs.
+*/
+struct thread_accounting
+{
+    std::string name;
+};
+
+
+namespace detail {
+inline std::chrono::nanoseconds to_nanoseconds (const timespec& ts)
+{
+    return std::chrono::seconds (ts.tv_sec) + std::chrono::nanoseconds (ts.tv_nsec);
+}
+
+/** Samples the calling thread's CPU time and context switches. */
+inline void sample_this_thread (thread_usage& usage)
+{
+   #if defined (CLOCK_THREAD_CPUTIME_ID)
+    if (timespec ts; clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+        usage.cpu_time = to_nanoseconds (ts);
+   #endif
+
+   #if defined (__linux__)
+    if (rusage ru; getrusage (RUSAGE_THREAD, &ru) == 0)
+    {
+        usage.voluntary_context_switches = ru.ru_nvcsw;
+        usage.involuntary_context_switches = ru.ru_nivcsw;
+    }
+   #endif
+}
+
+/** The state of an accounted thread, shared by the scl::thread and the
+    thread running. All members are guarded by the registry's mutex.
+*/
+struct thread_record
+{
+    explicit thread_record (std::string name_to_use)
+        : name (std::move (name_to_use))
+    {}
+
+    enum class status { starting, running, finished };
+
+    std::string name;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    status state = status::starting;
+    std::thread::id id;
+    thread_usage final_usage;
+
+   #if defined (__linux__)
+    pthread_t handle {};
+    pid_t tid = 0;
+   #endif
+};
+}
+
+
+/** Lists the accounted scl::threads that are currently running.
+    Usage of running threads is sampled on demand. On Linux this reads the
+    thread's CPU clock and /proc entry, elsewhere only wall time is
+    available until the thread finishes.
+*/
+class thread_registry
+{
+public:
+    struct entry
+    {
+        std::string name;
+        std::thread::id id;
+        thread_usage usage;
+    };
+
+    /** Returns the name, id and current usage of every running accounted thread. */
+    static std::vector<entry> snapshot()
+    {
+        std::scoped_lock _ (mutex);
+        std::vector<entry> entries;
+        entries.reserve (records.size());
+
+        for (auto r : records)
+            entries.push_back ({ r->name, r->id, usage_locked (*r) });
+
+        return entries;
+    }
+
+    /** Writes a table of snapshot() to os. */
+    static void dump (std::ostream& os)
+    {
+        const auto entries = snapshot();
+        auto to_ms = [] (std::chrono::nanoseconds ns) { return std::chrono::duration<double, std::milli> (ns).count(); };
+
+        os << std::left << std::setw (20) << "name" << std::setw (20) << "id"
+           << std::right << std::setw (12) << "wall ms" << std::setw (12) << "cpu ms"
+           << std::setw (12) << "voluntary" << std::setw (12) << "involuntary" << '\n';
+
+        for (auto& e : entries)
+            os << std::left << std::setw (20) << e.name << std::setw (20) << e.id
+               << std::right << std::fixed << std::setprecision (2)
+               << std::setw (12) << to_ms (e.usage.wall_time) << std::setw (12) << to_ms (e.usage.cpu_time)
+               << std::setw (12) << e.usage.voluntary_context_switches
+               << std::setw (12) << e.usage.involuntary_context_switches << '\n';
+    }
+
+private:
+    friend class thread;
+
+    static inline std::mutex mutex;
+    static inline std::vector<detail::thread_record*> records;
+
+    /** Called on the accounted thread before it runs its function. */
+    static void thread_started (detail::thread_record& r)
+    {
+        std::scoped_lock _ (mutex);
+        r.id = std::this_thread::get_id();
+
+       #if defined (__linux__)
+        r.handle = pthread_self();
+        r.tid = gettid();
+       #endif
+
+        r.state = detail::thread_record::status::running;
+        records.push_back (&r);
+    }
+
+    /** Called on the accounted thread once its function has returned. */
+    static void thread_finished (detail::thread_record& r)
+    {
+        thread_usage usage;
+        detail::sample_this_thread (usage);
+
+        std::scoped_lock _ (mutex);
+        usage.wall_time = std::chrono::steady_clock::now() - r.start;
+        r.final_usage = usage;
+        r.state = detail::thread_record::status::finished;
+        std::erase (records, &r);
+    }
+
+    static thread_usage usage (const detail::thread_record& r)
+    {
+        std::scoped_lock _ (mutex);
+        return usage_locked (r);
+    }
+
+    static thread_usage usage_locked (const detail::thread_record& r)
+    {
+        if (r.state == detail::thread_record::status::finished)
+            return r.final_usage;
+
+        thread_usage usage;
+        usage.wall_time = std::chrono::steady_clock::now() - r.start;
+
+        if (r.state == detail::thread_record::status::starting)
+            return usage;
+
+        // The thread can't exit whilst we hold the mutex as it has to
+        // remove itself, so its handle is valid here
+        if (r.id == std::this_thread::get_id())
+        {
+            detail::sample_this_thread (usage);
+            return usage;
+        }
+
+       #if defined (__linux__)
+        if (clockid_t clock; pthread_getcpuclockid (r.handle, &clock) == 0)
+            if (timespec ts; clock_gettime (clock, &ts) == 0)
+                usage.cpu_time = detail::to_nanoseconds (ts);
+
+        std::ifstream status ("/proc/self/task/" + std::to_string (r.tid) + "/status");
+
+        for (std::string key; status >> key;)
+        {
+            if (key == "voluntary_ctxt_switches:")
+                status >> usage.voluntary_context_switches;
+            else if (key == "nonvoluntary_ctxt_switches:")
+                status >> usage.involuntary_context_switches;
+        }
+       #endif
+
+        return usage;
+    }
+};
+
+}
@@ -0,0 +1,143 @@
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <ctime>
+#include <sstream>
+#include "arc.h"
+#include "safe_thread.h"
+
+using namespace std::literals;
+
+struct flag
+{
+    std::atomic<bool> value { false };
+};
+
+template<>
+struct scl::is_sync<flag> : std::true_type {};
+
+void nothing()
+{
+}
+
+struct spin_flags
+{
+    std::atomic<bool> spun { false }, stop { false };
+};
+
+template<>
+struct scl::is_sync<spin_flags> : std::true_type {};
+
+#if defined (CLOCK_THREAD_CPUTIME_ID)
+ constexpr auto cpu_time_to_spin = 1ms;
+#else
+ constexpr auto cpu_time_to_spin = 0ms;
+#endif
+
+/** The calling thread's usage, as seen through the registry. */
+scl::thread_usage this_thread_usage()
+{
+    for (auto& e : scl::thread_registry::snapshot())
+        if (e.id == std::this_thread::get_id())
+            return e.usage;
+
+    return {};
+}
+
+void spin_until (scl::arc<flag> stop)
+{
+    while (! stop->value.load (std::memory_order_relaxed))
+    {}
+}
+
+/** Spins until it has used some CPU time, so the test doesn't depend on how
+    the thread is scheduled, then until it's stopped.
+*/
+void spin_for_cpu_time (scl::arc<spin_flags> flags)
+{
+    while (this_thread_usage().cpu_time < cpu_time_to_spin)
+    {}
+
+    flags->spun = true;
+
+    while (! flags->stop.load (std::memory_order_relaxed))
+    {}
+}
+
+void sleep_until (scl::arc<flag> stop)
+{
+    while (! stop->value)
+        std::this_thread::sleep_for (1ms);
+}
+
+void test_usage()
+{
+    // Threads without accounting don't record anything
+    {
+        scl::thread t (nothing);
+        assert(! t.usage());
+    }
+
+    auto spinner_flags = scl::make_arc<spin_flags>();
+    auto stop_sleeper = scl::make_arc<flag>();
+    scl::thread spinner (scl::thread_accounting { "spinner" }, spin_for_cpu_time, auto (spinner_flags));
+    scl::thread sleeper (scl::thread_accounting { "sleeper" }, sleep_until, auto (stop_sleeper));
+
+    // Threads are listed once they've started running
+    while (! spinner_flags->spun || scl::thread_registry::snapshot().size() < 2)
+        std::this_thread::yield();
+
+    // Sampled on demand whilst running
+    [[maybe_unused]] const auto running = spinner.usage();
+    assert(running && running->wall_time > 0ns);
+    assert(running->cpu_time >= cpu_time_to_spin);
+
+    {
+        const auto entries = scl::thread_registry::snapshot();
+        assert(entries.size() == 2);
+
+        std::ostringstream table;
+        scl::thread_registry::dump (table);
+        assert(table.str().find ("spinner") != std::string::npos);
+        assert(table.str().find ("sleeper") != std::string::npos);
+
+        // Usage only ever goes up
+        [[maybe_unused]] const auto later = spinner.usage();
+        assert(later->wall_time >= running->wall_time);
+        assert(later->cpu_time >= running->cpu_time);
+    }
+
+    spinner_flags->stop = true;
+    stop_sleeper->value = true;
+    spinner.join();
+    sleeper.join();
+
+    assert(scl::thread_registry::snapshot().empty());
+
+    // Recorded when each thread exits
+    [[maybe_unused]] const auto spun = *spinner.usage();
+    [[maybe_unused]] const auto slept = *sleeper.usage();
+    assert(spun.wall_time >= running->wall_time);
+    assert(spun.cpu_time >= running->cpu_time);
+    assert(slept.wall_time > 0ns);
+    assert(spinner.usage()->wall_time == spun.wall_time);
+}
+
+void test_move()
+{
+    auto stop = scl::make_arc<flag>();
+    scl::thread t (scl::thread_accounting { "moved" }, spin_until, auto (stop));
+    scl::thread moved (std::move (t));
+    assert(! t.usage());
+    assert(moved.usage());
+
+    stop->value = true;
+}
+
+int main()
+{
+    test_usage();
+    test_move();
+
+    return 0;
+}
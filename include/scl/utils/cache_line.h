@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+
+namespace scl {
+
+/** The size to align data to to avoid false sharing between threads.
+    std::hardware_destructive_interference_size isn't used as its value can
+    vary with compiler flags, making it unsuitable for use in headers.
+*/
+#if defined (__APPLE__) && defined (__aarch64__)
+inline constexpr std::size_t cache_line_size = 128;
+#else
+inline constexpr std::size_t cache_line_size = 64;
+#endif
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "data_race_checker.h"
+#include <source_location>
+#include <utility>
+
+namespace scl {
+
+//==========================================
+//==========================================
+/**
+ *  Wraps a T so every member call through it is checked for data races,
+ *  without hand writing a scoped_check in each of T's functions.
+ *
+ *  operator-> only gives const access to the T and is checked as a read,
+ *  whether or not the wrapper is const. Mutation has to go through write().
+ *  Each check lasts until the returned access is destroyed, e.g. for the
+ *  whole expression:
+ *  @code
+ *  scl::data_race_checked<std::vector<int>> v;
+ *  v.write()->push_back (1);               // write
+ *  v->size();                              // read
+ *  auto r = v.read(); r->size(); r->back(); // read over several calls
+ *  @endcode
+ *
+ *  Without reflection the proxy can't tell which of T's member functions is
+ *  being called, so this errs towards reads. Making writes explicit means a
+ *  const member called through a non-const wrapper isn't falsely checked
+ *  as a write.
+ *
+ *  The state is stored inline so unlike data_race_registry there's no lookup
+ *  on each call. Races are reported against the address of the wrapper.
+ *  operator-> can't take a source_location, so prefer read() where reports
+ *  need the caller's location.
+ */
+template<typename T, typename State = check_state, check_level level = default_check_level>
+class data_race_checked
+{
+public:
+    /** Holds a check for as long as it lives and gives access to the T. */
+    template<check_type type, typename Pointer>
+    class access
+    {
+    public:
+        access (State& state, const void* object, Pointer p, const std::source_location& location)
+            : check (state, object, location),
+              pointer (p)
+        {}
+
+        access (const access&) = delete;
+        access& operator= (const access&) = delete;
+
+        Pointer operator->() const  { return pointer; }
+        auto& operator*() const     { return *pointer; }
+
+    private:
+        scoped_check<type, State, level> check;
+        Pointer pointer;
+    };
+
+    using read_access = access<check_type::read, const T*>;
+    using write_access = access<check_type::write, T*>;
+
+    /** Constructs the T in place from args. */
+    template<typename... Args>
+    explicit data_race_checked (Args&&... args)
+        : value (std::forward<Args> (args)...)
+    {}
+
+    data_race_checked (const data_race_checked&) = delete;
+    data_race_checked& operator= (const data_race_checked&) = delete;
+
+    /** Checked as a read, use write() to modify the T. */
+    read_access operator->() const
+    {
+        return read();
+    }
+
+    /** Returns a read check that lasts until the returned access is destroyed. */
+    read_access read (const std::source_location& location = std::source_location::current()) const
+    {
+        return { state, this, &value, location };
+    }
+
+    /** Returns a write check that lasts until the returned access is destroyed. */
+    write_access write (const std::source_location& location = std::source_location::current())
+    {
+        return { state, this, &value, location };
+    }
+
+private:
+    mutable State state;
+    T value;
+};
+
+}
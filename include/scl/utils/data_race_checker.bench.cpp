@@ -0,0 +1,162 @@
+#include <chrono>
+#include <memory>
+#include <numeric>
+#include <print>
+#include <ranges>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "data_race_checker.h"
+
+// Measures the cost of a scoped_check on an uncontended state and on one
+// shared by several reading threads, for check_state, striped_check_state
+// and happens_before_check_state.
+// Then the cost of each check_level compared to no check at all, and the
+// calls per second of registry checks through a handle, the per-thread
+// last-hit cache and an uncached lookup
+
+constexpr std::size_t num_checks = 10'000'000;
+
+template<scl::check_type type, typename State>
+double time_ns_per_check (State& state)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    for ([[maybe_unused]] auto i : std::views::iota (0uz, num_checks))
+        scl::scoped_check<type, State> _ (state);
+
+    return std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now() - start).count() / num_checks;
+}
+
+template<typename State>
+double time_ns_per_shared_read (std::size_t num_threads)
+{
+    State state;
+    std::vector<double> results (num_threads);
+
+    {
+        std::vector<std::jthread> threads;
+
+        for (auto i : std::views::iota (0uz, num_threads))
+            threads.emplace_back ([&, i] { results[i] = time_ns_per_check<scl::check_type::read> (state); });
+    }
+
+    return std::accumulate (results.begin(), results.end(), 0.0) / num_threads;
+}
+
+template<typename State>
+void run (const char* name)
+{
+    State state;
+    std::println ("{}", name);
+    std::println ("  read:                {:.2f} ns/check", time_ns_per_check<scl::check_type::read> (state));
+    std::println ("  write:               {:.2f} ns/check", time_ns_per_check<scl::check_type::write> (state));
+
+    for (auto num_threads : { 2uz, 4uz })
+        std::println ("  read on {} threads:   {:.2f} ns/check", num_threads, time_ns_per_shared_read<State> (num_threads));
+}
+
+struct counter
+{
+    scl::check_state state;
+    std::uint64_t value = 0;
+};
+
+[[gnu::noinline]] void increment_unchecked (counter& c)
+{
+    ++c.value;
+}
+
+template<scl::check_level level>
+[[gnu::noinline]] void increment (counter& c)
+{
+    scl::scoped_check<scl::check_type::write, scl::check_state, level> _ (c.state);
+    ++c.value;
+}
+
+template<typename Fn>
+double time_ns_per_call (Fn&& fn)
+{
+    counter c;
+    const auto start = std::chrono::steady_clock::now();
+
+    for ([[maybe_unused]] auto i : std::views::iota (0uz, num_checks))
+        fn (c);
+
+    return std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now() - start).count() / num_checks;
+}
+
+using registry = scl::data_race_registry<>;
+
+struct handle_counter
+{
+    registry::handle checks { this };
+    std::uint64_t value = 0;
+};
+
+[[gnu::noinline]] void increment_with_handle (handle_counter& c)
+{
+    scl::scoped_check<scl::check_type::write> _ (c.checks.get());
+    ++c.value;
+}
+
+[[gnu::noinline]] void increment_with_lookup (counter& c)
+{
+    scl::scoped_check<scl::check_type::write> _ (registry::get_state (&c));
+    ++c.value;
+}
+
+template<typename Object, typename Fn>
+double calls_per_second (Fn&& fn, std::size_t num_objects)
+{
+    // Register other objects so lookups have to scan populated buckets
+    std::vector<counter> others (10'000);
+
+    for (auto& o : others)
+        registry::get_state (&o);
+
+    // Alternating between objects misses the last-hit cache every call
+    std::vector<std::unique_ptr<Object>> objects (num_objects);
+
+    for (auto& o : objects)
+        o = std::make_unique<Object>();
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (auto i : std::views::iota (0uz, num_checks))
+        fn (*objects[i % num_objects]);
+
+    const auto seconds = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+
+    for (auto& o : others)
+        registry::on_destroy (&o);
+
+    if constexpr (std::is_same_v<Object, counter>)
+        for (auto& o : objects)
+            registry::on_destroy (o.get());
+
+    return num_checks / seconds;
+}
+
+// Off mode holds no state so there's nothing left to run
+static_assert (std::is_empty_v<scl::scoped_check<scl::check_type::write, scl::check_state, scl::check_level::off>>);
+
+int main()
+{
+    run<scl::check_state> ("check_state");
+    run<scl::striped_check_state<>> ("striped_check_state");
+    run<scl::happens_before_check_state> ("happens_before_check_state");
+
+    std::println ("levels");
+    std::println ("  unchecked:           {:.2f} ns/call", time_ns_per_call (increment_unchecked));
+    std::println ("  off:                 {:.2f} ns/call", time_ns_per_call (increment<scl::check_level::off>));
+    std::println ("  sampled:             {:.2f} ns/call", time_ns_per_call (increment<scl::check_level::sampled>));
+    std::println ("  full:                {:.2f} ns/call", time_ns_per_call (increment<scl::check_level::full>));
+
+    std::println ("registry");
+    std::println ("  handle:              {:.1f} M calls/s", calls_per_second<handle_counter> (increment_with_handle, 2) / 1e6);
+    std::println ("  last-hit cache:      {:.1f} M calls/s", calls_per_second<counter> (increment_with_lookup, 1) / 1e6);
+    std::println ("  uncached lookup:     {:.1f} M calls/s", calls_per_second<counter> (increment_with_lookup, 2) / 1e6);
+
+    return 0;
+}
@@ -4,14 +4,24 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <concepts>
 #include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <source_location>
 #include <thread>
 #include <vector>
 #include <atomic>
+#include "cache_line.h"
+#include "data_race_log.h"
+#include "data_race_stats.h"
+#include "happens_before.h"
+#include "lockset.h"
 
 #ifdef __GNUC__
  #pragma GCC diagnostic push
@@ -32,14 +42,19 @@
 // A writer enters a function and there is an active writer
 // A writer enters a function and there is an active reader
 //
-// N.B. This checks for recursion but there is a false positive if:
-// - A write starts
-// - A read on a separate thread starts
-// - That read finishes
-// - The original write continues but a data race is flagged
-// Although there is technically no race, this is probably unintended behaviour
+// Recursion isn't a race: the thread owning a write can nest reads and
+// writes, and a thread can nest a write in its read if no other thread is
+// reading at the time.
+// happens_before_check_state also finds races between accesses that don't
+// overlap in time
 //
-// Wait-free? (maybe the CMPX is only lock-free?)
+// check_state and striped_check_state are lock-free: each check is a single
+// CAS on one word, which only retries if another thread changed the state in
+// between. happens_before_check_state and lockset_check_state aren't: their
+// common cases are a single load but the rest take a per-state spin lock
+// (detail::scoped_spin_lock) to update their vector clock or candidate locks,
+// which can allocate. A thread preempted while holding it delays other threads
+// checking the same object.
 
 /** @note
  *  There's a bit of a debate if using the stack pointer (address of a local variable)
@@ -55,142 +70,957 @@
  *  using addresses.
 */
 
+// By default a data race aborts. Define DATA_RACE_REPORT to log races with
+// data_race_log and continue instead, or define DATA_RACE_DETECTED to handle
+// them yourself. It's used as the body of a function with a
+// `const data_race_violation& violation` parameter.
+
 namespace scl {
 
 #ifndef DATA_RACE_DETECTED
+ #if defined (DATA_RACE_REPORT)
+    #define DATA_RACE_DETECTED scl::data_race_log::report (violation);
+ #else
     #define DATA_RACE_DETECTED std::abort();
+ #endif
 #endif
 
+namespace detail {
+inline void data_race_detected ([[maybe_unused]] const data_race_violation& violation)
+{
+    DATA_RACE_DETECTED
+}
+}
+
+#undef DATA_RACE_DETECTED
+
 //==========================================
 //==========================================
+/** The reader count, writer's recursion depth and owning thread, packed in
+    to a single word so each check is one atomic RMW:
+    - bits 0-19:    number of active readers, including nested reads
+    - bits 20-31:   depth of nested writes, 0 if there's no writer
+    - bits 32-63:   compact ID of the writing thread if there's a writer,
+                    otherwise of the reading thread if only one thread is
+                    reading, otherwise 0
+*/
 struct check_state
 {
-    std::atomic<size_t> num_readers { 0 };
-    std::atomic<std::thread::id> last_thread_id { std::thread::id() };
-    std::atomic<bool> is_writing { false };
+    std::atomic<std::uint64_t> word { 0 };
 };
 
-bool can_write (const check_state& state)
+namespace detail {
+inline constexpr std::uint64_t reader_mask  = (std::uint64_t (1) << 20) - 1;
+inline constexpr int depth_shift            = 20;
+inline constexpr std::uint64_t depth_one    = std::uint64_t (1) << depth_shift;
+inline constexpr std::uint64_t depth_mask   = ((std::uint64_t (1) << 12) - 1) << depth_shift;
+inline constexpr int thread_shift           = 32;
+
+inline std::uint32_t thread_in (std::uint64_t word) noexcept
+{
+    return static_cast<std::uint32_t> (word >> thread_shift);
+}
+
+inline std::uint64_t with_thread (std::uint64_t word, std::uint32_t thread_id) noexcept
+{
+    return (word & ~(~std::uint64_t (0) << thread_shift)) | (std::uint64_t (thread_id) << thread_shift);
+}
+
+inline bool has_writer (std::uint64_t word) noexcept
+{
+    return (word & depth_mask) != 0;
+}
+
+/** The word once thread_id has started a read. A read nested in the
+    owner's write keeps it as the owner.
+*/
+inline std::uint64_t add_reader (std::uint64_t word, std::uint32_t thread_id) noexcept
+{
+    if (has_writer (word) || thread_in (word) == thread_id)
+        return word + 1;
+
+    return with_thread (word + 1, (word & reader_mask) == 0 ? thread_id : 0);
+}
+
+/** The word once thread_id has started a write, which becomes the owner. */
+inline std::uint64_t add_writer (std::uint64_t word, std::uint32_t thread_id) noexcept
+{
+    return with_thread (word + depth_one, thread_id);
+}
+
+/** True if a read by thread_id races the access in word: a write owned by
+    another thread.
+*/
+inline bool read_races (std::uint64_t word, std::uint32_t thread_id) noexcept
 {
-    return state.num_readers == 0;
+    return has_writer (word) && thread_in (word) != thread_id;
 }
 
-bool can_read (const check_state& state)
+/** True if a write by thread_id races the accesses in word: a write or a
+    read by another thread. A write nested in a read is only recursion if
+    no other thread is reading too.
+*/
+inline bool write_races (std::uint64_t word, std::uint32_t thread_id) noexcept
 {
-    return ! state.is_writing;
+    return (word & (depth_mask | reader_mask)) != 0 && thread_in (word) != thread_id;
 }
 
 //==========================================
-void read_started (check_state& state)
+/** The states the calling thread is reading.
+    Once two threads have read at the same time the word's thread is 0 and
+    stays 0 after one of them leaves, as one word can't record which reader
+    is left. A write nested in the remaining thread's read would then look
+    like a race, so this lets it check that every read left is its own.
+    Reads past the capacity aren't tracked, which can only cause a race to
+    be reported, never hide one.
+*/
+class active_reads
 {
-    auto this_thread_id = std::this_thread::get_id();
-    auto last_thread_id = state.last_thread_id.exchange (this_thread_id);
+public:
+    void add (const void* state) noexcept
+    {
+        if (size < states.size())
+            states[size++] = state;
+        else
+            ++num_untracked;
+    }
 
-    ++state.num_readers; // must be first
+    void remove (const void* state) noexcept
+    {
+        for (auto i = size; i > 0; --i)
+        {
+            if (states[i - 1] == state)
+            {
+                std::copy (states.begin() + i, states.begin() + size, states.begin() + (i - 1));
+                --size;
+                return;
+            }
+        }
 
-    if (state.is_writing)
+        if (num_untracked > 0)
+            --num_untracked;
+    }
+
+    std::uint64_t count (const void* state) const noexcept
     {
-        if (last_thread_id != this_thread_id)
-        { DATA_RACE_DETECTED }
-        // read during active write
+        return static_cast<std::uint64_t> (std::count (states.begin(), states.begin() + size, state));
     }
+
+private:
+    std::array<const void*, 16> states {};
+    std::size_t size = 0, num_untracked = 0;
+};
+
+inline active_reads& this_thread_reads() noexcept
+{
+    thread_local active_reads reads;
+    return reads;
+}
+
+/** True if word has no writer and all its reads of state are the calling
+    thread's, so a write nested in them is recursion.
+*/
+inline bool only_this_thread_reading (std::uint64_t word, const void* state) noexcept
+{
+    return ! has_writer (word) && this_thread_reads().count (state) == (word & reader_mask);
+}
 }
 
-void write_started (check_state& state)
+inline bool can_write (const check_state& state)
 {
-    auto this_thread_id = std::this_thread::get_id();
-    auto last_thread_id = state.last_thread_id.exchange (this_thread_id);
+    return (state.word.load (std::memory_order_acquire) & detail::reader_mask) == 0;
+}
 
-    if (state.is_writing.exchange (true))  // must be first
+inline bool can_read (const check_state& state)
+{
+    return ! detail::has_writer (state.word.load (std::memory_order_acquire));
+}
+
+//==========================================
+/** object and location are only used to report races. object defaults to
+    the address of the state.
+*/
+inline void read_started (check_state& state, const void* object = nullptr,
+                          const std::source_location& location = std::source_location::current())
+{
+    const auto this_thread_id = detail::this_thread_check_id();
+    auto old_word = state.word.load (std::memory_order_relaxed);
+
+    // Add a reader and update the reading thread in one go
+    while (! state.word.compare_exchange_weak (old_word, detail::add_reader (old_word, this_thread_id),
+                                               std::memory_order_acq_rel, std::memory_order_relaxed))
+    {}
+
+    detail::this_thread_reads().add (&state);
+
+    if (detail::read_races (old_word, this_thread_id))
     {
-        if (last_thread_id != this_thread_id)
-        { DATA_RACE_DETECTED }
-        // write during active write
+        detail::data_race_detected ({ object ? object : &state, this_thread_id, detail::thread_in (old_word),
+                                      check_type::read, check_type::write, location });
+        // read during another thread's write
     }
+}
 
-    if (state.num_readers > 0)
+inline void write_started (check_state& state, const void* object = nullptr,
+                           const std::source_location& location = std::source_location::current())
+{
+    const auto this_thread_id = detail::this_thread_check_id();
+    auto old_word = state.word.load (std::memory_order_relaxed);
+
+    // Add a level of writing and become the owner in one go
+    while (! state.word.compare_exchange_weak (old_word, detail::add_writer (old_word, this_thread_id),
+                                               std::memory_order_acq_rel, std::memory_order_relaxed))
+    {}
+
+    if (detail::write_races (old_word, this_thread_id)
+        && ! detail::only_this_thread_reading (old_word, &state))
     {
-        if (last_thread_id != this_thread_id)
-        { DATA_RACE_DETECTED }
-        // write during active read
+        detail::data_race_detected ({ object ? object : &state, this_thread_id, detail::thread_in (old_word),
+                                      check_type::write, detail::has_writer (old_word) ? check_type::write : check_type::read,
+                                      location });
+        // write during another thread's write or read
     }
 }
 
-void read_ended (check_state& state)
+inline void read_ended (check_state& state)
 {
-    --state.num_readers;
+    detail::this_thread_reads().remove (&state);
+    state.word.fetch_sub (1, std::memory_order_release);
 }
 
-void write_ended (check_state& state)
+inline void write_ended (check_state& state)
 {
-    state.is_writing = false;
+    state.word.fetch_sub (detail::depth_one, std::memory_order_release);
 }
 
-#undef DATA_RACE_DETECTED
 
 //==========================================
 //==========================================
-enum class check_type
+/** A reader-indicator version of check_state for read-heavy objects.
+    Readers are spread over cache-line isolated stripes by thread so
+    concurrent readers only contend if they share a stripe. Writers still
+    see every active reader by scanning the stripes, so writes cost
+    O(num_stripes) rather than O(1).
+
+    Each stripe packs its reader count and reading thread, and the writer
+    its depth and owner, like check_state, so recursive access is still
+    allowed.
+*/
+template<std::size_t num_stripes = 16>
+struct striped_check_state
 {
-    read,
-    write
+    static_assert (num_stripes > 0);
+
+    struct alignas(cache_line_size) stripe
+    {
+        std::atomic<std::uint64_t> word { 0 };
+    };
+
+    /** Holds the write depth and owning thread. */
+    alignas(cache_line_size) check_state writer;
+    std::array<stripe, num_stripes> readers;
 };
 
+template<std::size_t num_stripes>
+inline bool can_write (const striped_check_state<num_stripes>& state)
+{
+    return std::ranges::all_of (state.readers,
+                                [] (auto& s) { return (s.word.load (std::memory_order_acquire) & detail::reader_mask) == 0; });
+}
+
+template<std::size_t num_stripes>
+inline bool can_read (const striped_check_state<num_stripes>& state)
+{
+    return can_read (state.writer);
+}
+
 //==========================================
+// N.B. The reader's stripe update and the writer's depth update must both be
+// seq_cst so at least one of them sees the other.
+template<std::size_t num_stripes>
+inline void read_started (striped_check_state<num_stripes>& state, const void* object = nullptr,
+                          const std::source_location& location = std::source_location::current())
+{
+    const auto this_thread_id = detail::this_thread_check_id();
+    auto& word = state.readers[this_thread_id % num_stripes].word;
+    auto old_word = word.load (std::memory_order_relaxed);
+
+    while (! word.compare_exchange_weak (old_word, detail::add_reader (old_word, this_thread_id),
+                                         std::memory_order_seq_cst, std::memory_order_relaxed))
+    {}
+
+    detail::this_thread_reads().add (&state);
+
+    const auto writer_word = state.writer.word.load (std::memory_order_seq_cst);
+
+    if (detail::read_races (writer_word, this_thread_id))
+    {
+        detail::data_race_detected ({ object ? object : &state, this_thread_id, detail::thread_in (writer_word),
+                                      check_type::read, check_type::write, location });
+        // read during another thread's write
+    }
+}
+
+template<std::size_t num_stripes>
+inline void write_started (striped_check_state<num_stripes>& state, const void* object = nullptr,
+                           const std::source_location& location = std::source_location::current())
+{
+    const auto this_thread_id = detail::this_thread_check_id();
+    auto old_word = state.writer.word.load (std::memory_order_relaxed);
+
+    while (! state.writer.word.compare_exchange_weak (old_word, detail::add_writer (old_word, this_thread_id),
+                                                      std::memory_order_seq_cst, std::memory_order_relaxed))
+    {}
+
+    if (detail::write_races (old_word, this_thread_id))
+    {
+        detail::data_race_detected ({ object ? object : &state, this_thread_id, detail::thread_in (old_word),
+                                      check_type::write, check_type::write, location });
+        // write during another thread's write
+    }
+
+    // Only this thread's own stripe can hold its reads
+    const auto* own_stripe = &state.readers[this_thread_id % num_stripes];
+
+    for (auto& s : state.readers)
+    {
+        const auto reader_word = s.word.load (std::memory_order_seq_cst);
+
+        if (detail::write_races (reader_word, this_thread_id)
+            && ! (&s == own_stripe && detail::only_this_thread_reading (reader_word, &state)))
+        {
+            detail::data_race_detected ({ object ? object : &state, this_thread_id, detail::thread_in (reader_word),
+                                          check_type::write, check_type::read, location });
+            // write during another thread's read
+        }
+    }
+}
+
+template<std::size_t num_stripes>
+inline void read_ended (striped_check_state<num_stripes>& state)
+{
+    detail::this_thread_reads().remove (&state);
+    state.readers[detail::this_thread_check_id() % num_stripes].word.fetch_sub (1, std::memory_order_release);
+}
+
+template<std::size_t num_stripes>
+inline void write_ended (striped_check_state<num_stripes>& state)
+{
+    write_ended (state.writer);
+}
+
+
+//==========================================
+//==========================================
+/** A FastTrack style state that detects accesses that aren't ordered by
+    happens-before, whether or not they overlap in time. Needs
+    DATA_RACE_HAPPENS_BEFORE so clocks are passed between threads by
+    scl::thread start and join, synchronized_value and any sync_clock.
+
+    The last write is kept as an epoch, a thread and its clock value at
+    the time. Reads are kept as an epoch too until two reads aren't ordered,
+    then as a vector clock until the next write. Accesses in the same epoch
+    as the last one from the same thread, the common case, are a single
+    load. Others take a short spin lock and compare against the caller's
+    vector clock.
+
+    Only the start of each access is checked so the ended functions do
+    nothing, and recursion is never a race as it's all on one thread.
+    Synchronisation the checker isn't told about, like std::mutex or
+    atomics, isn't seen so will cause false positives.
+*/
+struct happens_before_check_state
+{
+    std::atomic<std::uint64_t> write_epoch { 0 };
+    std::atomic<std::uint64_t> read_epoch { 0 };
+    std::atomic_flag lock;
+
+    // Only used under the lock, once reads have been shared
+    detail::vector_clock read_clock;
+};
+
+namespace detail {
+/** read_epoch when the reads are held in read_clock. */
+inline constexpr std::uint64_t shared_read_epoch = ~std::uint64_t (0);
+
+/** Guards the parts of happens_before_check_state and lockset_check_state
+    that don't fit in one atomic word. It yields while contended rather than
+    parking the thread. Races are reported while it's held, so a
+    DATA_RACE_DETECTED handler mustn't check the same object again.
+*/
+struct scoped_spin_lock
+{
+    explicit scoped_spin_lock (std::atomic_flag& f)
+        : flag (f)
+    {
+        while (flag.test_and_set (std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+
+    ~scoped_spin_lock()
+    {
+        flag.clear (std::memory_order_release);
+    }
+
+    std::atomic_flag& flag;
+};
+}
+
+inline void read_started (happens_before_check_state& state, const void* object = nullptr,
+                          const std::source_location& location = std::source_location::current())
+{
+    const auto epoch = detail::this_thread_epoch();
+
+    // Same epoch: this thread has already read since it last synchronised
+    if (state.read_epoch.load (std::memory_order_relaxed) == epoch)
+        return;
+
+    const auto this_thread_id = detail::this_thread_check_id();
+    const auto& clock = detail::this_thread_clock();
+    detail::scoped_spin_lock _ (state.lock);
+
+    if (const auto write_epoch = state.write_epoch.load (std::memory_order_relaxed);
+        ! clock.contains (write_epoch))
+    {
+        detail::data_race_detected ({ object ? object : &state, this_thread_id, detail::epoch_thread (write_epoch),
+                                      check_type::read, check_type::write, location });
+        // read not ordered after the last write
+    }
+
+    if (const auto read_epoch = state.read_epoch.load (std::memory_order_relaxed);
+        read_epoch == detail::shared_read_epoch)
+    {
+        state.read_clock.set (this_thread_id, detail::epoch_clock (epoch));
+    }
+    else if (clock.contains (read_epoch))
+    {
+        state.read_epoch.store (epoch, std::memory_order_relaxed);
+    }
+    else
+    {
+        // Concurrent reads aren't a race but both need remembering
+        state.read_clock.clear();
+        state.read_clock.set (detail::epoch_thread (read_epoch), detail::epoch_clock (read_epoch));
+        state.read_clock.set (this_thread_id, detail::epoch_clock (epoch));
+        state.read_epoch.store (detail::shared_read_epoch, std::memory_order_relaxed);
+    }
+}
+
+inline void write_started (happens_before_check_state& state, const void* object = nullptr,
+                           const std::source_location& location = std::source_location::current())
+{
+    const auto epoch = detail::this_thread_epoch();
+
+    // Same epoch: this thread has already written since it last synchronised
+    if (state.write_epoch.load (std::memory_order_relaxed) == epoch)
+        return;
+
+    const auto this_thread_id = detail::this_thread_check_id();
+    const auto& clock = detail::this_thread_clock();
+    detail::scoped_spin_lock _ (state.lock);
+
+    if (const auto write_epoch = state.write_epoch.load (std::memory_order_relaxed);
+        ! clock.contains (write_epoch))
+    {
+        detail::data_race_detected ({ object ? object : &state, this_thread_id, detail::epoch_thread (write_epoch),
+                                      check_type::write, check_type::write, location });
+        // write not ordered after the last write
+    }
+
+    if (const auto read_epoch = state.read_epoch.load (std::memory_order_relaxed);
+        read_epoch == detail::shared_read_epoch)
+    {
+        if (const auto reader = state.read_clock.first_not_before (clock); reader != 0)
+            detail::data_race_detected ({ object ? object : &state, this_thread_id, reader,
+                                          check_type::write, check_type::read, location });
+        // write not ordered after a shared read
+
+        state.read_clock.clear();
+        state.read_epoch.store (0, std::memory_order_relaxed);
+    }
+    else if (! clock.contains (read_epoch))
+    {
+        detail::data_race_detected ({ object ? object : &state, this_thread_id, detail::epoch_thread (read_epoch),
+                                      check_type::write, check_type::read, location });
+        // write not ordered after the last read
+    }
+
+    state.write_epoch.store (epoch, std::memory_order_relaxed);
+}
+
+inline void read_ended (happens_before_check_state&)
+{
+}
+
+inline void write_ended (happens_before_check_state&)
+{
+}
+
+
+//==========================================
+//==========================================
+/** An Eraser style state that checks every access to an object is protected
+    by the same lock, whether or not accesses overlap in time. Needs
+    DATA_RACE_LOCKSET so synchronized_value records the locks held in apply.
+
+    An object starts owned by the first thread to access it, which can do
+    so without a lock, e.g. to initialise it. Once another thread accesses
+    it the candidate locks are those held then, and every later access
+    narrows them to the locks it holds too. A race is reported once if the
+    object has been written since it was shared and no lock is left.
+
+    An object whose candidate locks never empty is consistently protected,
+    see candidate_locks, so other locks taken around it aren't needed.
+    The owner's accesses are a single load, others take a short spin lock.
+*/
+struct lockset_check_state
+{
+    /** Bits 0-1 are the phase, bit 2 is set if the last access was a
+        write and bits 32-63 are the owner, or last thread once shared.
+    */
+    std::atomic<std::uint64_t> word { 0 };
+    std::atomic_flag lock;
+
+    // Only used under the lock, once shared
+    std::vector<const void*> candidates;
+    bool reported = false;
+};
+
+namespace detail {
+enum class lockset_phase : std::uint64_t
+{
+    virgin          = 0,
+    exclusive       = 1,
+    shared          = 2,
+    shared_modified = 3
+};
+
+inline constexpr std::uint64_t lockset_phase_mask = 0b11;
+inline constexpr std::uint64_t lockset_write_bit  = 0b100;
+
+inline lockset_phase lockset_phase_of (std::uint64_t word) noexcept
+{
+    return static_cast<lockset_phase> (word & lockset_phase_mask);
+}
+
+inline std::uint64_t make_lockset_word (lockset_phase p, check_type type, std::uint32_t thread_id) noexcept
+{
+    return static_cast<std::uint64_t> (p)
+            | (type == check_type::write ? lockset_write_bit : 0)
+            | (std::uint64_t (thread_id) << thread_shift);
+}
+
 template<check_type type>
+inline void lockset_access (lockset_check_state& state, const void* object, const std::source_location& location)
+{
+    const auto this_thread_id = detail::this_thread_check_id();
+    const auto old_word = state.word.load (std::memory_order_relaxed);
+
+    // Owner: still only accessed by this thread
+    if (lockset_phase_of (old_word) == lockset_phase::exclusive && thread_in (old_word) == this_thread_id)
+        return;
+
+    scoped_spin_lock _ (state.lock);
+    const auto word = state.word.load (std::memory_order_relaxed);
+    auto new_phase = lockset_phase_of (word);
+    const auto& held = held_locks();
+
+    switch (new_phase)
+    {
+        case lockset_phase::virgin:
+            new_phase = lockset_phase::exclusive;
+            break;
+
+        case lockset_phase::exclusive:
+            if (thread_in (word) == this_thread_id)
+                return;
+
+            state.candidates = held;
+            new_phase = type == check_type::write ? lockset_phase::shared_modified : lockset_phase::shared;
+            break;
+
+        case lockset_phase::shared:
+        case lockset_phase::shared_modified:
+            std::erase_if (state.candidates, [&] (auto l) { return std::ranges::find (held, l) == held.end(); });
+
+            if (type == check_type::write)
+                new_phase = lockset_phase::shared_modified;
+
+            break;
+    }
+
+    if (new_phase == lockset_phase::shared_modified && state.candidates.empty() && ! state.reported)
+    {
+        state.reported = true;
+        data_race_detected ({ object ? object : &state, this_thread_id, thread_in (word),
+                              type, (word & lockset_write_bit) ? check_type::write : check_type::read, location });
+        // no lock held by every access since the object was shared
+    }
+
+    state.word.store (make_lockset_word (new_phase, type, this_thread_id), std::memory_order_relaxed);
+}
+}
+
+inline void read_started (lockset_check_state& state, const void* object = nullptr,
+                          const std::source_location& location = std::source_location::current())
+{
+    detail::lockset_access<check_type::read> (state, object, location);
+}
+
+inline void write_started (lockset_check_state& state, const void* object = nullptr,
+                           const std::source_location& location = std::source_location::current())
+{
+    detail::lockset_access<check_type::write> (state, object, location);
+}
+
+inline void read_ended (lockset_check_state&)
+{
+}
+
+inline void write_ended (lockset_check_state&)
+{
+}
+
+/** The locks that have protected every access since the object was shared,
+    identified by address. Empty until another thread has accessed it.
+*/
+inline std::vector<const void*> candidate_locks (lockset_check_state& state)
+{
+    detail::scoped_spin_lock _ (state.lock);
+    return state.candidates;
+}
+
+
+//==========================================
+//==========================================
+/** Wraps another state to count how the object is accessed as well as
+    checking it, see data_race_registry::snapshot to export the counts.
+*/
+template<typename State = check_state>
+struct counted_check_state
+{
+    State state;
+    access_stats stats;
+};
+
+template<typename State>
+inline void read_started (counted_check_state<State>& state, const void* object = nullptr,
+                          const std::source_location& location = std::source_location::current())
+{
+    state.stats.read_started();
+    read_started (state.state, object ? object : &state, location);
+}
+
+template<typename State>
+inline void write_started (counted_check_state<State>& state, const void* object = nullptr,
+                           const std::source_location& location = std::source_location::current())
+{
+    state.stats.write_started();
+    write_started (state.state, object ? object : &state, location);
+}
+
+template<typename State>
+inline void read_ended (counted_check_state<State>& state)
+{
+    read_ended (state.state);
+    state.stats.read_ended();
+}
+
+template<typename State>
+inline void write_ended (counted_check_state<State>& state)
+{
+    write_ended (state.state);
+}
+
+//==========================================
+//==========================================
+/** How much checking scoped_check and data_race_registry do:
+    - off:      nothing, the checks compile away entirely
+    - sampled:  1 in DATA_RACE_CHECK_SAMPLE_RATE checks per thread
+    - full:     every check
+
+    The default is set with DATA_RACE_CHECK_LEVEL (0, 1 or 2) before
+    including this header, e.g. full in debug builds and sampled in
+    production. Races are only found in sampled mode if both of the
+    overlapping accesses are sampled so it relies on repetition.
+*/
+enum class check_level
+{
+    off     = 0,
+    sampled = 1,
+    full    = 2
+};
+
+#ifndef DATA_RACE_CHECK_LEVEL
+ #define DATA_RACE_CHECK_LEVEL 2
+#endif
+
+#ifndef DATA_RACE_CHECK_SAMPLE_RATE
+ #define DATA_RACE_CHECK_SAMPLE_RATE 64
+#endif
+
+inline constexpr check_level default_check_level = static_cast<check_level> (DATA_RACE_CHECK_LEVEL);
+inline constexpr std::uint32_t check_sample_rate = DATA_RACE_CHECK_SAMPLE_RATE;
+
+static_assert (check_sample_rate > 0);
+
+namespace detail {
+/** Returns true for 1 in check_sample_rate calls on each thread. */
+inline bool should_sample() noexcept
+{
+    thread_local std::uint32_t countdown = 1;
+
+    if (--countdown != 0)
+        return false;
+
+    countdown = check_sample_rate;
+    return true;
+}
+
+template<check_type type, typename State>
+void check_started (State& state, const void* object, const std::source_location& location)
+{
+    if constexpr (type == check_type::read)
+        read_started (state, object, location);
+    else
+        write_started (state, object, location);
+}
+
+template<check_type type, typename State>
+void check_ended (State& state)
+{
+    if constexpr (type == check_type::read)
+        read_ended (state);
+    else
+        write_ended (state);
+}
+}
+
+//==========================================
+template<check_type type, typename State = check_state, check_level level = default_check_level>
 struct scoped_check
 {
-    scoped_check (check_state& check_state)
-        : state (check_state)
+    scoped_check (State& check_state, const void* object = nullptr,
+                  const std::source_location& location = std::source_location::current())
+        : state (level == check_level::full || detail::should_sample() ? &check_state : nullptr)
     {
-        if constexpr (type == check_type::read)
-            read_started (state);
-        else
-            write_started (state);
+        if (state)
+            detail::check_started<type> (*state, object, location);
     }
 
     ~scoped_check()
     {
-        if constexpr (type == check_type::read)
-            read_ended (state);
-        else
-            write_ended (state);
+        if (state)
+            detail::check_ended<type> (*state);
     }
 
-    check_state& state;
+    /** nullptr if this check wasn't sampled. */
+    State* state;
+};
+
+template<check_type type, typename State>
+struct scoped_check<type, State, check_level::off>
+{
+    scoped_check (State&, const void* = nullptr, const std::source_location& = std::source_location::current())
+    {}
 };
 
 
 //==========================================
 //==========================================
-template<typename Tag = check_state>
+/** In sampled mode the on_*_started/ended hooks are separate calls, so
+    whether each start was sampled is kept on a fixed size per-thread stack
+    to be matched by its end. In off mode get_state returns a single shared
+    state without a lookup so it compiles away along with the checks.
+
+    Each thread caches the last object it looked up, so repeated calls on
+    the same object skip the extrinsic_storage lookup. Each entry has a
+    generation that on_destroy bumps, so only caches of the destroyed object
+    are invalidated. Objects that can hold a member should use a handle
+    instead which never looks up.
+*/
+template<typename Tag = check_state, check_level level = default_check_level>
 class data_race_registry {
-    static inline auto tags    = extrinsic_storage<Tag>{};
-    static inline auto log     = std::ofstream{ "data-race-violations.log" };
+    /** Entries are never freed, only reused, so a cached entry can always
+        be read to check its generation. extrinsic_storage doesn't reset a
+        reused slot's value so on_destroy resets the state instead.
+    */
+    struct entry {
+        Tag state;
+        std::atomic<std::uint64_t> generation{ 0 };
+    };
+
+    static inline auto tags    = extrinsic_storage<entry>{};
+
+    struct last_hit {
+        const void* object = nullptr;
+        entry* e = nullptr;
+        std::uint64_t generation = 0;
+    };
+
+    static inline auto find_or_insert(const void* pobj) noexcept -> Tag* {
+        thread_local last_hit cache;
+
+        // relaxed: destroying an object happens-before any later use of its address
+        if (cache.object == pobj && cache.e->generation.load(std::memory_order_relaxed) == cache.generation) {
+            return &cache.e->state;
+        }
+
+        // This const cast should be tidied up
+        auto e = tags.find_or_insert(const_cast<void*> (pobj));
+        if (! e) { return nullptr; }
+
+        cache = { pobj, e, e->generation.load(std::memory_order_relaxed) };
+        return &e->state;
+    }
+
+    /** Whether each start on this thread was sampled, a bit per nesting
+        level. Starts nested deeper than the bits are never sampled so their
+        ends match without needing to allocate.
+    */
+    struct sampled_stack {
+        std::uint64_t bits = 0;
+        std::uint32_t depth = 0;
+
+        auto push(bool sampled) noexcept -> bool {
+            constexpr auto capacity = std::numeric_limits<std::uint64_t>::digits;
+
+            if (depth < capacity) {
+                const auto bit = std::uint64_t(1) << depth;
+                bits = sampled ? (bits | bit) : (bits & ~bit);
+            } else {
+                sampled = false;
+            }
+
+            ++depth;
+            return sampled;
+        }
+
+        auto pop() noexcept -> bool {
+            constexpr auto capacity = std::numeric_limits<std::uint64_t>::digits;
+            --depth;
+            return depth < capacity && (bits & (std::uint64_t(1) << depth)) != 0;
+        }
+    };
+
+    static inline auto this_thread_sampled() noexcept -> sampled_stack& {
+        thread_local sampled_stack stack;
+        return stack;
+    }
+
+    template<check_type type>
+    static inline auto on_started(void* pobj, const std::source_location& location) noexcept -> void {
+        if constexpr (level == check_level::sampled) {
+            if (! this_thread_sampled().push(detail::should_sample()))
+                return;
+        }
+
+        if (auto p = find_or_insert(pobj)) { detail::check_started<type> (*p, pobj, location); }
+    }
+
+    template<check_type type>
+    static inline auto on_ended(void* pobj) noexcept -> void {
+        if constexpr (level == check_level::sampled) {
+            if (! this_thread_sampled().pop())
+                return;
+        }
+
+        if (auto p = find_or_insert(pobj)) { detail::check_ended<type> (*p); }
+    }
+
 public:
 
     static inline auto& get_state(const void* pobj) noexcept {
-        // This const cast should be tidied up
-        return *tags.find_or_insert(const_cast<void*> (pobj));
+        if constexpr (level == check_level::off) {
+            static Tag unused;
+            return unused;
+        } else {
+            return *find_or_insert(pobj);
+        }
+    }
+
+    /** Copies the stats of the max_objects most accessed objects, most
+        accessed first. Needs a Tag with access_stats, e.g. counted_check_state.
+        Stats are reset by on_destroy so an object at a reused address only
+        reports its own accesses. Objects registered or destroyed
+        concurrently may be missed.
+    */
+    static inline auto snapshot(std::size_t max_objects = std::numeric_limits<std::size_t>::max()) -> std::vector<object_access_stats>
+        requires requires (Tag& t) { { t.stats } -> std::same_as<access_stats&>; } {
+        std::vector<object_access_stats> stats;
+
+        tags.for_each([&] (void* pobj, entry& e) {
+            auto& t = e.state;
+            stats.push_back({ pobj,
+                              t.stats.reads.load(std::memory_order_relaxed),
+                              t.stats.writes.load(std::memory_order_relaxed),
+                              t.stats.num_threads(),
+                              t.stats.overlapping_reads.load(std::memory_order_relaxed) });
+        });
+
+        const auto num = std::min(max_objects, stats.size());
+        std::ranges::partial_sort(stats, stats.begin() + static_cast<std::ptrdiff_t>(num), std::ranges::greater{},
+                                  &object_access_stats::accesses);
+        stats.resize(num);
+
+        return stats;
+    }
+
+    static inline auto on_destroy(void* pobj) noexcept -> void {
+        if constexpr (level != check_level::off) {
+            // The object is being destroyed so no check on it can be in flight.
+            // Invalidate any thread's cache of the entry and reset its state
+            // before the slot can be claimed by a new object at any address
+            if (auto e = tags.find(pobj)) {
+                e->generation.fetch_add(1, std::memory_order_relaxed);
+                std::destroy_at(&e->state);
+                std::construct_at(&e->state);
+            }
+
+            tags.erase(pobj);
+        }
     }
 
-    static inline auto on_destroy(void* pobj) noexcept -> void { tags.erase(pobj); }
+    /** Looks up an object's state once when constructed and calls
+        on_destroy when destroyed, so an object can hold one as a member
+        and check each call without a lookup:
+        @code
+        data_race_registry<>::handle checks { this };
+        scoped_check<check_type::write> _ (checks.get());
+        @endcode
+    */
+    class handle {
+    public:
+        explicit handle(const void* pobj) noexcept
+            : object(pobj), state(&get_state(pobj)) {}
+
+        ~handle() { on_destroy(const_cast<void*> (object)); }
+
+        handle(const handle&) = delete;
+        handle& operator=(const handle&) = delete;
+
+        auto get() const noexcept -> Tag& { return *state; }
+
+    private:
+        const void* object;
+        Tag* state;
+    };
 
 
-    static inline auto on_read_started(void* pobj) noexcept -> void {
-        if (auto p = tags.find_or_insert(pobj)) { read_started (*p); }
+    static inline auto on_read_started(void* pobj, const std::source_location& location = std::source_location::current()) noexcept -> void {
+        if constexpr (level != check_level::off) { on_started<check_type::read> (pobj, location); }
     }
 
-    static inline auto on_write_started(void* pobj) noexcept -> void {
-        if (auto p = tags.find_or_insert(pobj)) { write_started (*p); }
+    static inline auto on_write_started(void* pobj, const std::source_location& location = std::source_location::current()) noexcept -> void {
+        if constexpr (level != check_level::off) { on_started<check_type::write> (pobj, location); }
     }
 
     static inline auto on_read_ended(void* pobj) noexcept -> void {
-        if (auto p = tags.find_or_insert(pobj)) { read_ended (*p); }
+        if constexpr (level != check_level::off) { on_ended<check_type::read> (pobj); }
     }
 
     static inline auto on_write_ended(void* pobj) noexcept -> void {
-        if (auto p = tags.find_or_insert(pobj)) { write_ended (*p); }
+        if constexpr (level != check_level::off) { on_ended<check_type::write> (pobj); }
     }
 };
 
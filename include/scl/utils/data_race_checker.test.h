@@ -8,56 +8,58 @@
 #include <span>
 #include <atomic>
 
-template <typename T>
+template <typename T, typename State = scl::check_state>
 class test_vector
 {
+  using registry = scl::data_race_registry<State>;
+
 public:
   test_vector() {
     // Create the entry (might allocate)
-    scl::data_race_registry<>::get_state (this);
+    registry::get_state (this);
   }
 
   ~test_vector() {
-    scl::data_race_registry<>::on_destroy (this);
+    registry::on_destroy (this);
   }
 
   void reserve (size_t new_cap) {
-    scl::scoped_check<scl::check_type::write> _ (scl::data_race_registry<>::get_state (this));
+    scl::scoped_check<scl::check_type::write, State> _ (registry::get_state (this));
     data.resize (new_cap);
   }
 
   void clear() {
-    scl::scoped_check<scl::check_type::write> _ (scl::data_race_registry<>::get_state (this));
+    scl::scoped_check<scl::check_type::write, State> _ (registry::get_state (this));
     data.clear();
   }
 
   void push_back(const T& value) {
-    scl::scoped_check<scl::check_type::write> _ (scl::data_race_registry<>::get_state (this));
+    scl::scoped_check<scl::check_type::write, State> _ (registry::get_state (this));
     data.push_back(value);
   }
 
   // Test delegating a write-write
   void push_back_2(const T& v1, const T& v2) {
-    scl::scoped_check<scl::check_type::write> _ (scl::data_race_registry<>::get_state (this));
+    scl::scoped_check<scl::check_type::write, State> _ (registry::get_state (this));
     push_back(v1);
     push_back(v2);
   }
 
   // Test delegating a write-read
   T& push_back_and_return(const T& value) {
-    scl::scoped_check<scl::check_type::write> _ (scl::data_race_registry<>::get_state (this));
+    scl::scoped_check<scl::check_type::write, State> _ (registry::get_state (this));
     data.push_back(value);
     return data.back();
   }
 
   void pop_back() {
-    scl::scoped_check<scl::check_type::write> _ (scl::data_race_registry<>::get_state (this));
+    scl::scoped_check<scl::check_type::write, State> _ (registry::get_state (this));
     data.pop_back();
   }
 
   // Test delegating a write-read
   const T& push_back_return_old_back(const T& value) {
-    scl::scoped_check<scl::check_type::write> _ (scl::data_race_registry<>::get_state (this));
+    scl::scoped_check<scl::check_type::write, State> _ (registry::get_state (this));
 
     auto& old_back = back();
     push_back(value);
@@ -65,47 +67,47 @@ public:
   }
 
   T& back() {
-    scl::scoped_check<scl::check_type::read> _ (scl::data_race_registry<>::get_state (this));
+    scl::scoped_check<scl::check_type::read, State> _ (registry::get_state (this));
     return data.back();
   }
 
   const T& back() const {
-    scl::scoped_check<scl::check_type::read> _ (scl::data_race_registry<>::get_state (this));
+    scl::scoped_check<scl::check_type::read, State> _ (registry::get_state (this));
     return data.back();
   }
 
   // Test delegating a read-write
   // This wouldn't normally occur as you'd have a const function calling a non-const function
   const T& back_with_default_write() {
-    scl::scoped_check<scl::check_type::read> _ (scl::data_race_registry<>::get_state (this));
+    scl::scoped_check<scl::check_type::read, State> _ (registry::get_state (this));
     push_back(T());
     return data.back();
   }
 
   T& operator[](size_t index) {
-    scl::scoped_check<scl::check_type::read> _ (scl::data_race_registry<>::get_state (this));
+    scl::scoped_check<scl::check_type::read, State> _ (registry::get_state (this));
     return data[index];
   }
 
   size_t size() const {
-    scl::scoped_check<scl::check_type::read> _ (scl::data_race_registry<>::get_state (this));
+    scl::scoped_check<scl::check_type::read, State> _ (registry::get_state (this));
     return data.size();
   }
 
   bool empty() const {
-    scl::scoped_check<scl::check_type::read> _ (scl::data_race_registry<>::get_state (this));
+    scl::scoped_check<scl::check_type::read, State> _ (registry::get_state (this));
     return data.empty();
   }
 
   size_t capacity() const {
-    scl::scoped_check<scl::check_type::read> _ (scl::data_race_registry<>::get_state (this));
+    scl::scoped_check<scl::check_type::read, State> _ (registry::get_state (this));
     return data.capacity();
   }
 
   // Test delegating a read-read
   std::pair<size_t, size_t> size_and_capacity() const
   {
-    scl::scoped_check<scl::check_type::read> _ (scl::data_race_registry<>::get_state (this));
+    scl::scoped_check<scl::check_type::read, State> _ (registry::get_state (this));
     return { size(), capacity() };
   }
 
@@ -113,9 +115,10 @@ private:
   std::vector<T> data;
 };
 
+template<typename State = scl::check_state>
 inline void test_no_data_race()
 {
-  test_vector<size_t> vec;
+  test_vector<size_t, State> vec;
 
   // Fill the vector first
    for (auto c : std::ranges::iota_view (0uz, 1'000uz))
@@ -140,10 +143,11 @@ inline void test_no_data_race()
     t.join();
 }
 
+template<typename State = scl::check_state>
 inline void test_data_race()
 {
   std::vector<std::thread> threads;
-  test_vector<size_t> vec;
+  test_vector<size_t, State> vec;
 
   threads.emplace_back([&]
                        {
@@ -172,9 +176,10 @@ inline void test_data_race()
     t.join();
 }
 
+template<typename State = scl::check_state>
 inline void test_no_data_race_read_read()
 {
-  test_vector<size_t> vec;
+  test_vector<size_t, State> vec;
 
   // Fill the vector first
   for (auto c : std::ranges::iota_view (0uz, 1'000uz))
@@ -203,25 +208,28 @@ inline void test_no_data_race_read_read()
     t.join();
 }
 
+template<typename State = scl::check_state>
 inline void test_no_data_race_read_write()
 {
-  test_vector<size_t> vec;
+  test_vector<size_t, State> vec;
   volatile auto c = 0uz;
   vec.push_back (auto (c));
   c = vec.back_with_default_write();
 }
 
+template<typename State = scl::check_state>
 inline void test_no_data_race_write_read()
 {
-  test_vector<size_t> vec;
+  test_vector<size_t, State> vec;
   volatile auto c = 0uz;
   vec.push_back(auto(c));
   c = vec.push_back_return_old_back(auto (c));
 }
 
+template<typename State = scl::check_state>
 inline void test_no_data_race_write_write()
 {
-  test_vector<size_t> vec;
+  test_vector<size_t, State> vec;
   volatile auto c = 0uz;
   vec.push_back_2(auto (c), auto (c));
 }
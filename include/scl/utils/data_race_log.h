@@ -0,0 +1,258 @@
+#pragma once
+
+#include "reclamation.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <source_location>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#ifndef DATA_RACE_LOG_FILE
+ #define DATA_RACE_LOG_FILE "data-race-violations.log"
+#endif
+
+namespace scl {
+
+//==========================================
+//==========================================
+enum class check_type
+{
+    read,
+    write
+};
+
+/** A detected data race. The thread IDs are the compact IDs the checker
+    assigns to each thread, not std::thread::ids. other_thread_id is 0 if
+    several threads were reading.
+*/
+struct data_race_violation
+{
+    const void* object = nullptr;
+    std::uint32_t thread_id = 0;
+    std::uint32_t other_thread_id = 0;
+    check_type access = check_type::read;
+    check_type other_access = check_type::read;
+    std::source_location location;
+};
+
+
+//==========================================
+//==========================================
+/**
+ *  Collects violations for the report-and-continue mode, enabled by
+ *  defining DATA_RACE_REPORT before including data_race_checker.h.
+ *
+ *  Racing threads push to their own fixed size single-producer ring so
+ *  reporting never blocks or allocates, if a ring is full the violation is
+ *  dropped and counted. A background thread drains the rings in batches to
+ *  DATA_RACE_LOG_FILE. Only the first violation from each call site is
+ *  written in full, later ones are counted and summarised when the log is
+ *  closed at exit.
+ */
+class data_race_log
+{
+public:
+    static constexpr std::size_t ring_capacity = 256;
+
+    /** Returns the log, starting its flush thread the first time.
+        It's intentionally leaked so threads can still report races during
+        static destruction. Its flush thread is stopped and pending races
+        and the summary are written by std::atexit instead. Races reported
+        after that are kept but never written.
+    */
+    static data_race_log& instance()
+    {
+        static data_race_log& log = []() -> data_race_log&
+        {
+            auto l = new data_race_log (DATA_RACE_LOG_FILE);
+            std::atexit ([] { instance().close(); });
+            return *l;
+        }();
+
+        return log;
+    }
+
+    /** Records a violation from the calling thread. Wait-free once the
+        thread has reported its first violation.
+    */
+    static void report (const data_race_violation& violation) noexcept
+    {
+        instance().push (violation);
+    }
+
+    explicit data_race_log (const std::string& path, std::chrono::milliseconds flush_interval = std::chrono::milliseconds (100))
+        : file (path),
+          flush_thread ([this, flush_interval]
+                        {
+                            std::unique_lock l (wake_mutex);
+
+                            while (! stopping)
+                            {
+                                wake.wait_for (l, flush_interval);
+                                l.unlock();
+                                flush();
+                                l.lock();
+                            }
+                        })
+    {}
+
+    ~data_race_log()
+    {
+        close();
+    }
+
+    /** Stops the flush thread then writes anything pending and the summary.
+        Does nothing if already closed.
+    */
+    void close()
+    {
+        {
+            std::scoped_lock _ (wake_mutex);
+
+            if (std::exchange (stopping, true))
+                return;
+        }
+
+        wake.notify_one();
+        flush_thread.join();
+        flush();
+        write_summary();
+    }
+
+    /** N.B. A thread's first push allocates its ring in this_thread_record(),
+        so it isn't wait-free and as this is noexcept a failed allocation
+        terminates. Later pushes from the thread never allocate.
+    */
+    void push (const data_race_violation& violation) noexcept
+    {
+        auto& r = rings.this_thread_record();
+        const auto tail = r.tail.load (std::memory_order_relaxed);
+
+        // acquire: the flush thread has finished reading the slot
+        if (tail - r.head.load (std::memory_order_acquire) == ring_capacity)
+        {
+            dropped.fetch_add (1, std::memory_order_relaxed);
+            return;
+        }
+
+        r.slots[tail % ring_capacity] = violation;
+
+        // release: publish the slot to the flush thread
+        r.tail.store (tail + 1, std::memory_order_release);
+    }
+
+    /** Drains every thread's ring to the file. Called periodically by the
+        flush thread but can be called to write pending violations now.
+    */
+    void flush()
+    {
+        std::scoped_lock _ (flush_mutex);
+
+        rings.for_each ([this] (ring& r)
+                        {
+                            const auto tail = r.tail.load (std::memory_order_acquire);
+                            auto head = r.head.load (std::memory_order_relaxed);
+
+                            for (; head != tail; ++head)
+                                write (r.slots[head % ring_capacity]);
+
+                            r.head.store (head, std::memory_order_release);
+                        });
+
+        file.flush();
+    }
+
+    /** The number of violations flushed so far, including duplicates. */
+    std::size_t num_reported() const
+    {
+        std::scoped_lock _ (flush_mutex);
+        return reported;
+    }
+
+    /** The number of distinct call sites flushed so far. */
+    std::size_t num_call_sites() const
+    {
+        std::scoped_lock _ (flush_mutex);
+        return call_sites.size();
+    }
+
+    /** The number of violations dropped because a ring was full. */
+    std::size_t num_dropped() const
+    {
+        return dropped.load (std::memory_order_relaxed);
+    }
+
+private:
+    struct ring
+    {
+        explicit ring (std::thread::id id)
+            : owner (id)
+        {}
+
+        const std::thread::id owner;
+        ring* next = nullptr;
+        alignas (cache_line_size) std::atomic<std::size_t> head { 0 };
+        alignas (cache_line_size) std::atomic<std::size_t> tail { 0 };
+        std::array<data_race_violation, ring_capacity> slots;
+    };
+
+    using call_site = std::tuple<std::string, std::uint_least32_t, std::uint_least32_t>;
+
+    std::ofstream file;
+    detail::thread_records<ring> rings;
+    std::atomic<std::size_t> dropped { 0 };
+
+    mutable std::mutex flush_mutex;
+    std::map<call_site, std::size_t> call_sites;
+    std::size_t reported = 0;
+
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread flush_thread;
+
+    static const char* to_string (check_type type)
+    {
+        return type == check_type::read ? "read" : "write";
+    }
+
+    void write (const data_race_violation& v)
+    {
+        ++reported;
+        auto& count = call_sites[{ v.location.file_name(), v.location.line(), v.location.column() }];
+
+        if (count++ > 0)
+            return;
+
+        file << "data race: " << to_string (v.access) << " of " << v.object
+             << " on thread " << v.thread_id
+             << " during " << to_string (v.other_access) << " on thread " << v.other_thread_id
+             << " at " << v.location.file_name() << ':' << v.location.line() << ':' << v.location.column()
+             << " in " << v.location.function_name() << '\n';
+    }
+
+    void write_summary()
+    {
+        std::scoped_lock _ (flush_mutex);
+
+        for (auto& [site, count] : call_sites)
+            if (count > 1)
+                file << count << " data races at " << std::get<0> (site) << ':' << std::get<1> (site) << ':' << std::get<2> (site) << '\n';
+
+        if (auto d = dropped.load(); d > 0)
+            file << d << " data races dropped\n";
+
+        file.flush();
+    }
+};
+
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "happens_before.h"
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <utility>
+
+namespace scl {
+
+//==========================================
+//==========================================
+/** Relaxed counters of how an object is accessed, kept by
+    counted_check_state. In sampled mode only sampled accesses are counted.
+*/
+struct access_stats
+{
+    std::atomic<std::uint64_t> reads { 0 };
+    std::atomic<std::uint64_t> writes { 0 };
+
+    /** Reads that started while another read was active. */
+    std::atomic<std::uint64_t> overlapping_reads { 0 };
+
+    /** A bit per thread ID modulo 64, so the distinct thread count is exact
+        up to 64 threads and a lower bound after that.
+    */
+    std::atomic<std::uint64_t> thread_mask { 0 };
+
+    std::atomic<std::uint32_t> active_readers { 0 };
+
+    void read_started() noexcept
+    {
+        reads.fetch_add (1, std::memory_order_relaxed);
+        add_this_thread();
+
+        if (active_readers.fetch_add (1, std::memory_order_relaxed) > 0)
+            overlapping_reads.fetch_add (1, std::memory_order_relaxed);
+    }
+
+    void read_ended() noexcept
+    {
+        active_readers.fetch_sub (1, std::memory_order_relaxed);
+    }
+
+    void write_started() noexcept
+    {
+        writes.fetch_add (1, std::memory_order_relaxed);
+        add_this_thread();
+    }
+
+    std::uint32_t num_threads() const noexcept
+    {
+        return static_cast<std::uint32_t> (std::popcount (thread_mask.load (std::memory_order_relaxed)));
+    }
+
+private:
+    void add_this_thread() noexcept
+    {
+        const auto bit = std::uint64_t (1) << (detail::this_thread_check_id() % 64);
+
+        // Avoid the RMW once the thread is recorded as that's the common case
+        if ((thread_mask.load (std::memory_order_relaxed) & bit) == 0)
+            thread_mask.fetch_or (bit, std::memory_order_relaxed);
+    }
+};
+
+/** A copy of an object's access_stats, returned by
+    data_race_registry::snapshot.
+*/
+struct object_access_stats
+{
+    const void* object = nullptr;
+    std::uint64_t reads = 0;
+    std::uint64_t writes = 0;
+    std::uint32_t threads = 0;
+    std::uint64_t overlapping_reads = 0;
+
+    std::uint64_t accesses() const noexcept
+    {
+        return reads + writes;
+    }
+};
+
+/** Writes the stats as a JSON array with an object per entry. */
+inline void write_json (std::ostream& os, std::span<const object_access_stats> stats)
+{
+    os << "[";
+
+    for (bool first = true; auto& s : stats)
+    {
+        os << (std::exchange (first, false) ? "\n" : ",\n")
+           << "  { \"object\": \"" << s.object << "\""
+           << ", \"reads\": " << s.reads
+           << ", \"writes\": " << s.writes
+           << ", \"threads\": " << s.threads
+           << ", \"overlapping_reads\": " << s.overlapping_reads << " }";
+    }
+
+    os << "\n]\n";
+}
+
+/** Writes the stats as CSV with a header row. */
+inline void write_csv (std::ostream& os, std::span<const object_access_stats> stats)
+{
+    os << "object,reads,writes,threads,overlapping_reads\n";
+
+    for (auto& s : stats)
+        os << s.object << ',' << s.reads << ',' << s.writes << ','
+           << s.threads << ',' << s.overlapping_reads << '\n';
+}
+
+}
@@ -0,0 +1,131 @@
+#include <print>
+
+// Use exit(1) as ctest seems to count a raised signal as a pass...
+#define DATA_RACE_DETECTED { std::println ("ERROR: data race detected"); std::exit(1); }
+#include "data_race_checker.h"
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <ranges>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using state = scl::counted_check_state<>;
+using registry = scl::data_race_registry<state>;
+
+struct counter
+{
+  ~counter() {
+    registry::on_destroy (this);
+  }
+
+  void increment() {
+    scl::scoped_check<scl::check_type::write, state> _ (registry::get_state (this));
+    ++value;
+  }
+
+  int get() const {
+    scl::scoped_check<scl::check_type::read, state> _ (registry::get_state (this));
+    return value;
+  }
+
+  int value = 0;
+};
+
+void test_snapshot()
+{
+  counter busy, quiet;
+
+  for ([[maybe_unused]] auto i : std::views::iota (0, 100))
+    busy.increment();
+
+  quiet.increment();
+
+  {
+    std::vector<std::jthread> threads;
+
+    for ([[maybe_unused]] auto _ : std::views::iota (0, 3))
+      threads.emplace_back ([&]
+                            {
+                              for ([[maybe_unused]] auto i : std::views::iota (0, 1'000))
+                                if (busy.get() != 100)
+                                  std::exit(1);
+                            });
+  }
+
+  [[maybe_unused]] const auto all = registry::snapshot();
+  assert(all.size() == 2);
+  assert(all[0].object == &busy);
+  assert(all[0].reads == 3'000);
+  assert(all[0].writes == 100);
+  assert(all[0].threads == 4);
+  assert(all[1].object == &quiet);
+  assert(all[1].accesses() == 1);
+  assert(all[1].threads == 1);
+
+  [[maybe_unused]] const auto top = registry::snapshot (1);
+  assert(top.size() == 1);
+  assert(top[0].object == &busy);
+}
+
+void test_export()
+{
+  counter c;
+  c.increment();
+  [[maybe_unused]] const auto v = c.get();
+
+  const auto stats = registry::snapshot();
+  std::ostringstream json, csv;
+  scl::write_json (json, stats);
+  scl::write_csv (csv, stats);
+
+  std::ostringstream object;
+  object << static_cast<const void*> (&c);
+
+  assert(json.str().starts_with ("["));
+  assert(json.str().contains ("\"object\": \"" + object.str() + "\", \"reads\": 1, \"writes\": 1, \"threads\": 1, \"overlapping_reads\": 0"));
+  assert(csv.str() == "object,reads,writes,threads,overlapping_reads\n" + object.str() + ",1,1,1,0\n");
+}
+
+void test_destroyed_objects_are_removed()
+{
+  {
+    counter c;
+    c.increment();
+  }
+
+  assert(registry::snapshot().empty());
+}
+
+void test_reused_address()
+{
+  alignas (counter) std::byte storage[sizeof (counter)];
+
+  auto old = std::construct_at (reinterpret_cast<counter*> (storage));
+
+  for ([[maybe_unused]] auto i : std::views::iota (0, 5))
+    old->increment();
+
+  std::destroy_at (old);
+
+  // A new object at the same address starts with no accesses
+  auto fresh = std::construct_at (reinterpret_cast<counter*> (storage));
+  registry::get_state (fresh);
+
+  [[maybe_unused]] const auto stats = registry::snapshot();
+  assert(stats.size() == 1);
+  assert(stats[0].object == fresh);
+  assert(stats[0].accesses() == 0);
+  assert(stats[0].threads == 0);
+
+  std::destroy_at (fresh);
+}
+
+int main()
+{
+  test_snapshot();
+  test_export();
+  test_destroyed_objects_are_removed();
+  test_reused_address();
+}
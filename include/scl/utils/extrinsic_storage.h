@@ -152,6 +152,25 @@ public:
         lookup(pobj, lookup_mode::erase);
     }
 
+    //--------------------------------------------------------------------------
+    //  for_each( f ) - calls f( pobj, value ) for each entry
+    //
+    //  Entries inserted or erased concurrently may or may not be visited, and
+    //  the caller must synchronize any access to the values themselves
+    //
+    template<typename F>
+    auto for_each(F&& f) -> void {
+        for (auto& bucket : buckets) {
+            for (auto pchunk = &bucket; pchunk; pchunk = pchunk->next.load()) {
+                for ( auto i = std::size_t{0}; i < ChunkSize; ++i ) {
+                    if (auto pobj = pchunk->keys[i].load(); pobj != nullptr) {
+                        f(pobj, pchunk->values[i]);
+                    }
+                }
+            }
+        }
+    }
+
 private:
     static inline constexpr std::size_t ChunkSize = 32;
     struct chunk {
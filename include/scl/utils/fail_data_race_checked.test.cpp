@@ -0,0 +1,37 @@
+#include <print>
+
+// Use exit(1) as ctest seems to count a raised signal as a pass...
+#define DATA_RACE_DETECTED { std::println ("ERROR: data race detected"); std::exit(1); }
+#include "data_race_checked.h"
+#include <ranges>
+#include <thread>
+#include <vector>
+
+int main()
+{
+  scl::data_race_checked<std::vector<size_t>> vec;
+  std::vector<std::thread> threads;
+
+  threads.emplace_back([&]
+                       {
+                         for (;;)
+                         {
+                           for (auto c : std::ranges::iota_view (0uz, 1'000uz))
+                             vec.write()->push_back (c);
+
+                           vec.write()->clear();
+                         }
+                       });
+
+  for ([[maybe_unused]] auto _ : std::ranges::iota_view (0, 3))
+    threads.emplace_back([&]
+                         {
+                           for (;;)
+                           {
+                             [[maybe_unused]] volatile auto c = vec->size();
+                           }
+                         });
+
+  for (auto& t : threads)
+    t.join(); // won't return
+}
@@ -0,0 +1,34 @@
+#include <print>
+
+// Use exit(1) as ctest seems to count a raised signal as a pass...
+#define DATA_RACE_DETECTED { std::println ("ERROR: data race detected"); std::exit(1); }
+#define DATA_RACE_HAPPENS_BEFORE 1
+#include "data_race_checked.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// The writes never overlap in time, so the overlap checker misses them, but
+// a relaxed flag doesn't order them so it's still a race
+scl::data_race_checked<std::vector<int>, scl::happens_before_check_state> vec;
+std::atomic<bool> written { false };
+
+int main()
+{
+  std::thread first ([]
+                     {
+                       vec.write()->push_back (1);
+                       written.store (true, std::memory_order_relaxed);
+                     });
+
+  std::thread second ([]
+                      {
+                        while (! written.load (std::memory_order_relaxed))
+                          std::this_thread::yield();
+
+                        vec.write()->push_back (2);
+                      });
+
+  first.join();
+  second.join();
+}
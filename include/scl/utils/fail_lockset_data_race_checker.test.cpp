@@ -0,0 +1,33 @@
+#include <print>
+
+// Use exit(1) as ctest seems to count a raised signal as a pass...
+#define DATA_RACE_DETECTED { std::println ("ERROR: data race detected"); std::exit(1); }
+#define DATA_RACE_LOCKSET 1
+#include "data_race_checker.h"
+#include "../synchronized_value.h"
+#include <thread>
+
+struct counter
+{
+  void increment() {
+    scl::scoped_check<scl::check_type::write, scl::lockset_check_state> _ (state);
+    ++value;
+  }
+
+  scl::lockset_check_state state;
+  int value = 0;
+};
+
+// Each thread locks something but not the same thing so nothing protects
+// the counter, even though the accesses never overlap
+int main()
+{
+  counter shared;
+  scl::synchronized_value<int> first, second;
+
+  for (auto* guard : { &first, &second, &first })
+  {
+    std::thread t ([&] { apply ([&] (int&) { shared.increment(); }, *guard); });
+    t.join();
+  }
+}
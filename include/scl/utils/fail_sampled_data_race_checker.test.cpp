@@ -0,0 +1,11 @@
+#include <print>
+
+// Use exit(1) as ctest seems to count a raised signal as a pass...
+#define DATA_RACE_DETECTED { std::println ("ERROR: data race detected"); std::exit(1); }
+#define DATA_RACE_CHECK_LEVEL 1
+#include "data_race_checker.test.h"
+
+int main()
+{
+  test_data_race(); // won't return once both sides of a race are sampled
+}
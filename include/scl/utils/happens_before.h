@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+// Vector clocks for the happens-before data race checker, see
+// happens_before_check_state in data_race_checker.h.
+//
+// Each thread has a vector clock of the last clock it has seen from every
+// other thread. A sync_clock carries a thread's clock across a
+// synchronisation point: released by one thread and acquired by the next.
+// scl::thread releases to the threads it starts and acquires from them when
+// joined, and synchronized_value releases and acquires around apply.
+//
+// Define DATA_RACE_HAPPENS_BEFORE to 1 to enable this, consistently in every
+// translation unit, as it adds a sync_clock to each synchronized_value.
+// Otherwise sync_clock is empty and propagating clocks compiles away.
+
+#ifndef DATA_RACE_HAPPENS_BEFORE
+ #define DATA_RACE_HAPPENS_BEFORE 0
+#endif
+
+namespace scl {
+
+inline constexpr bool happens_before_enabled = DATA_RACE_HAPPENS_BEFORE != 0;
+
+namespace detail {
+/** A small non-zero ID for the calling thread that fits in check_state.
+    IDs aren't reused so this wraps after 2^32 threads have checked.
+*/
+inline std::uint32_t this_thread_check_id() noexcept
+{
+    static std::atomic<std::uint32_t> next_id { 1 };
+    thread_local const std::uint32_t id = next_id.fetch_add (1, std::memory_order_relaxed);
+    return id;
+}
+
+/** A thread ID and a clock value of that thread, packed in to a word so it
+    can be compared and stored atomically. 0 is before everything.
+*/
+inline std::uint64_t make_epoch (std::uint32_t thread_id, std::uint32_t clock) noexcept
+{
+    return (std::uint64_t (thread_id) << 32) | clock;
+}
+
+inline std::uint32_t epoch_thread (std::uint64_t epoch) noexcept
+{
+    return static_cast<std::uint32_t> (epoch >> 32);
+}
+
+inline std::uint32_t epoch_clock (std::uint64_t epoch) noexcept
+{
+    return static_cast<std::uint32_t> (epoch);
+}
+
+//==========================================
+/** A clock per thread, indexed by check ID. Threads it hasn't seen are 0. */
+class vector_clock
+{
+public:
+    std::uint32_t get (std::uint32_t thread_id) const noexcept
+    {
+        return thread_id < clocks.size() ? clocks[thread_id] : 0;
+    }
+
+    void set (std::uint32_t thread_id, std::uint32_t clock)
+    {
+        if (thread_id >= clocks.size())
+            clocks.resize (thread_id + 1);
+
+        clocks[thread_id] = clock;
+    }
+
+    void increment (std::uint32_t thread_id)
+    {
+        set (thread_id, get (thread_id) + 1);
+    }
+
+    /** Takes the maximum of each thread's clock. */
+    void join (const vector_clock& other)
+    {
+        if (other.clocks.size() > clocks.size())
+            clocks.resize (other.clocks.size());
+
+        std::ranges::transform (other.clocks, clocks, clocks.begin(),
+                                [] (auto a, auto b) { return std::max (a, b); });
+    }
+
+    /** True if the access at epoch happens-before this clock. */
+    bool contains (std::uint64_t epoch) const noexcept
+    {
+        return epoch_clock (epoch) <= get (epoch_thread (epoch));
+    }
+
+    /** Returns the first thread whose clock isn't contained by other, or 0
+        if this whole clock happens-before it.
+    */
+    std::uint32_t first_not_before (const vector_clock& other) const noexcept
+    {
+        for (std::uint32_t i = 0; i < clocks.size(); ++i)
+            if (clocks[i] > other.get (i))
+                return i;
+
+        return 0;
+    }
+
+    void clear() noexcept
+    {
+        clocks.clear();
+    }
+
+private:
+    std::vector<std::uint32_t> clocks;
+};
+
+/** The calling thread's clock. Its own entry starts at 1 so its first
+    accesses don't look like they happen-before everything.
+*/
+inline vector_clock& this_thread_clock()
+{
+    thread_local vector_clock clock = []
+    {
+        vector_clock c;
+        c.set (this_thread_check_id(), 1);
+        return c;
+    }();
+
+    return clock;
+}
+
+/** The calling thread's current epoch. */
+inline std::uint64_t this_thread_epoch()
+{
+    const auto id = this_thread_check_id();
+    return make_epoch (id, this_thread_clock().get (id));
+}
+}
+
+
+//==========================================
+//==========================================
+/**
+ *  Carries the happens-before relation across a synchronisation point the
+ *  checker can't see by itself. Call release() before the point, e.g. an
+ *  unlock or a store-release, and acquire() after the matching one, e.g. a
+ *  lock or a load-acquire, so accesses either side aren't reported as racing.
+ *
+ *  It isn't thread-safe itself: the synchronisation it describes has to
+ *  order the release and the acquire.
+ */
+class sync_clock
+{
+public:
+#if DATA_RACE_HAPPENS_BEFORE
+    void release()
+    {
+        auto& c = detail::this_thread_clock();
+        clock = c;
+        c.increment (detail::this_thread_check_id());
+    }
+
+    void acquire()
+    {
+        detail::this_thread_clock().join (clock);
+    }
+
+private:
+    detail::vector_clock clock;
+#else
+    void release() {}
+    void acquire() {}
+#endif
+};
+
+namespace detail {
+/** Acquires the clocks on construction and releases them when destroyed,
+    for use while holding the locks they belong to.
+*/
+template<typename... Clocks>
+class scoped_sync_clocks
+{
+public:
+    explicit scoped_sync_clocks (Clocks&... clocks_to_use)
+        : clocks (clocks_to_use...)
+    {
+        std::apply ([] (auto&... cs) { (cs.acquire(), ...); }, clocks);
+    }
+
+    ~scoped_sync_clocks()
+    {
+        std::apply ([] (auto&... cs) { (cs.release(), ...); }, clocks);
+    }
+
+    scoped_sync_clocks (const scoped_sync_clocks&) = delete;
+    scoped_sync_clocks& operator= (const scoped_sync_clocks&) = delete;
+
+private:
+    std::tuple<Clocks&...> clocks;
+};
+
+/** The clocks passed from a thread to one it starts and back when joined. */
+struct fork_clocks
+{
+    sync_clock start, end;
+};
+
+/** Releases the calling thread's clock to a thread it's about to start.
+    nullptr if happens-before checking isn't enabled.
+*/
+inline std::shared_ptr<fork_clocks> fork()
+{
+    if constexpr (! happens_before_enabled)
+    {
+        return nullptr;
+    }
+    else
+    {
+        auto clocks = std::make_shared<fork_clocks>();
+        clocks->start.release();
+        return clocks;
+    }
+}
+}
+
+}
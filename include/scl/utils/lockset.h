@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+// The locks each thread holds, for the lockset data race checker, see
+// lockset_check_state in data_race_checker.h.
+//
+// synchronized_value adds its mutex to the calling thread's held locks for
+// the duration of apply and async_apply, so the checker can tell which lock
+// protected each access.
+//
+// Define DATA_RACE_LOCKSET to 1 to enable this, otherwise recording the
+// held locks compiles away.
+
+#ifndef DATA_RACE_LOCKSET
+ #define DATA_RACE_LOCKSET 0
+#endif
+
+namespace scl {
+
+inline constexpr bool lockset_enabled = DATA_RACE_LOCKSET != 0;
+
+namespace detail {
+/** The locks the calling thread holds, identified by address. */
+inline std::vector<const void*>& held_locks()
+{
+    thread_local std::vector<const void*> locks;
+    return locks;
+}
+
+/** Adds the locks to the calling thread's held locks while in scope. */
+template<typename... Locks>
+class scoped_held_locks
+{
+public:
+    explicit scoped_held_locks ([[maybe_unused]] const Locks&... locks)
+    {
+        if constexpr (lockset_enabled)
+            (held_locks().push_back (&locks), ...);
+    }
+
+    ~scoped_held_locks()
+    {
+        if constexpr (lockset_enabled)
+            held_locks().resize (held_locks().size() - sizeof... (Locks));
+    }
+
+    scoped_held_locks (const scoped_held_locks&) = delete;
+    scoped_held_locks& operator= (const scoped_held_locks&) = delete;
+};
+}
+
+}
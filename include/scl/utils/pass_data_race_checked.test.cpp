@@ -0,0 +1,85 @@
+#include <print>
+
+// Use exit(1) as ctest seems to count a raised signal as a pass...
+#define DATA_RACE_DETECTED { std::println ("ERROR: data race detected"); std::exit(1); }
+#include "data_race_checked.h"
+#include <cassert>
+#include <ranges>
+#include <thread>
+#include <vector>
+
+using checked_vector = scl::data_race_checked<std::vector<size_t>>;
+
+void test_single_thread()
+{
+  checked_vector vec;
+
+  for (auto c : std::ranges::iota_view (0uz, 1'000uz))
+    vec.write()->push_back (c);
+
+  assert(vec->size() == 1'000);
+
+  // Nested accesses on the same thread aren't races
+  {
+    auto w = vec.write();
+    w->push_back (vec->back());
+    assert(vec.read()->size() == 1'001);
+  }
+
+  auto r = vec.read();
+  assert(r->front() == 0);
+  assert((*r)[1'000] == 999);
+}
+
+void test_concurrent_reads()
+{
+  checked_vector vec;
+
+  for (auto c : std::ranges::iota_view (0uz, 1'000uz))
+    vec.write()->push_back (c);
+
+  const auto& shared = vec;
+  std::vector<std::thread> threads;
+
+  for ([[maybe_unused]] auto _ : std::ranges::iota_view (0, 3))
+    threads.emplace_back([&]
+                         {
+                           for ([[maybe_unused]] auto _ : std::ranges::iota_view (0uz, 1'000'000uz))
+                           {
+                             [[maybe_unused]] volatile auto c = 0uz;
+
+                             if (! shared->empty())
+                               c = shared->back();
+                           }
+                         });
+
+  for (auto& t : threads)
+    t.join();
+}
+
+// operator-> is a read even through a non-const wrapper, so const member
+// calls on several threads don't race
+void test_concurrent_reads_through_non_const()
+{
+  checked_vector vec (1'000uz);
+  std::vector<std::thread> threads;
+
+  for ([[maybe_unused]] auto _ : std::ranges::iota_view (0, 3))
+    threads.emplace_back([&]
+                         {
+                           for ([[maybe_unused]] auto _ : std::ranges::iota_view (0uz, 1'000'000uz))
+                           {
+                             [[maybe_unused]] volatile auto c = vec->size();
+                           }
+                         });
+
+  for (auto& t : threads)
+    t.join();
+}
+
+int main()
+{
+  test_single_thread();
+  test_concurrent_reads();
+  test_concurrent_reads_through_non_const();
+}
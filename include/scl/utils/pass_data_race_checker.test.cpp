@@ -6,6 +6,69 @@
 
 #define DATA_RACE_DETECTED { std::println ("ERROR: data race detected"); std::exit(1); }
 #include "data_race_checker.test.h"
+#include <cassert>
+#include <memory>
+
+template<typename State = scl::check_state>
+class handle_counter
+{
+  using registry = scl::data_race_registry<State>;
+
+public:
+  void increment() {
+    scl::scoped_check<scl::check_type::write, State> _ (checks.get());
+    ++value;
+  }
+
+  size_t get() const {
+    scl::scoped_check<scl::check_type::read, State> _ (checks.get());
+    return value;
+  }
+
+  const State& state() const {
+    return checks.get();
+  }
+
+private:
+  typename registry::handle checks { this };
+  size_t value = 0;
+};
+
+template<typename State = scl::check_state>
+inline void test_handle()
+{
+  handle_counter<State> counter;
+  assert(&counter.state() == &scl::data_race_registry<State>::get_state (&counter));
+
+  for (size_t i = 0; i < 1'000; ++i)
+    counter.increment();
+
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < 3; ++i)
+    threads.emplace_back([&]
+                         {
+                           for (int j = 0; j < 100'000; ++j)
+                             if (counter.get() != 1'000)
+                               std::exit(1);
+                         });
+
+  for (auto& t : threads)
+    t.join();
+}
+
+template<typename State = scl::check_state>
+inline void test_cached_lookup_after_destroy()
+{
+  // Destroying and reusing an address mustn't leave a stale cached state
+  for (int i = 0; i < 1'000; ++i)
+  {
+    auto vec = std::make_unique<test_vector<int, State>>();
+    vec->push_back (i);
+    [[maybe_unused]] auto& state = scl::data_race_registry<State>::get_state (vec.get());
+    assert(&state == &scl::data_race_registry<State>::get_state (vec.get()));
+  }
+}
 
 int main()
 {
@@ -16,4 +79,17 @@ int main()
   test_no_data_race_read_write();
   test_no_data_race_write_read();
   test_no_data_race_write_write();
+
+  // Cached lookups
+  test_handle();
+  test_cached_lookup_after_destroy();
+
+  // Reader-indicator state
+  using striped = scl::striped_check_state<>;
+  test_no_data_race<striped>();
+  test_no_data_race_read_read<striped>();
+  test_no_data_race_read_write<striped>();
+  test_no_data_race_write_read<striped>();
+  test_no_data_race_write_write<striped>();
+  test_handle<striped>();
 }
\ No newline at end of file
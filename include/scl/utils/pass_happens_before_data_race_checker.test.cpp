@@ -0,0 +1,162 @@
+#include <print>
+
+// Use exit(1) as ctest seems to count a raised signal as a pass...
+#define DATA_RACE_DETECTED { std::println ("ERROR: data race detected"); std::exit(1); }
+#define DATA_RACE_HAPPENS_BEFORE 1
+#include "data_race_checked.h"
+#include "../safe_thread.h"
+#include "../synchronized_value.h"
+#include "../task_scope.h"
+#include <atomic>
+#include <cassert>
+#include <ranges>
+#include <thread>
+#include <vector>
+
+using checked_vector = scl::data_race_checked<std::vector<int>, scl::happens_before_check_state>;
+
+checked_vector handed_over;
+
+void append_to_handed_over()
+{
+  handed_over.write()->push_back (2);
+  assert(handed_over->size() == 2);
+}
+
+// Accesses on different threads that never overlap are ordered by start and join
+void test_thread_start_and_join()
+{
+  handed_over.write()->push_back (1);
+
+  {
+    scl::thread t (append_to_handed_over);
+  }
+
+  handed_over.write()->push_back (3);
+  assert(handed_over->size() == 3);
+}
+
+checked_vector scoped;
+
+void append_to_scoped()
+{
+  scoped.write()->push_back (2);
+}
+
+// task_scope's threads are ordered by start and join in the same way
+void test_task_scope()
+{
+  scoped.write()->push_back (1);
+
+  {
+    scl::task_scope scope;
+    scope.spawn (append_to_scoped);
+  }
+
+  scoped.write()->push_back (3);
+  assert(scoped->size() == 3);
+}
+
+scl::synchronized_value<checked_vector> shared;
+
+void append_to_shared (int n)
+{
+  for (auto i : std::views::iota (0, n))
+    apply ([i] (checked_vector& v) { v.write()->push_back (i); }, shared);
+}
+
+// Accesses under a synchronized_value's lock are ordered by its clock
+void test_synchronized_value()
+{
+  {
+    std::vector<scl::thread> threads;
+
+    for ([[maybe_unused]] auto _ : std::views::iota (0, 4))
+      threads.push_back (scl::thread (append_to_shared, 1'000));
+  }
+
+  [[maybe_unused]] const auto size = apply ([] (checked_vector& v) { return v->size(); }, shared);
+  assert(size == 4'000);
+}
+
+// Reads on several threads aren't ordered with each other but aren't a race
+checked_vector read_only { 10, 0 };
+
+void read_only_reader()
+{
+  for ([[maybe_unused]] auto _ : std::views::iota (0, 1'000))
+    if (read_only->size() != 10)
+      std::exit(1);
+}
+
+void test_unordered_reads()
+{
+  read_only.write()->push_back (0);
+  read_only.write()->pop_back();
+
+  std::vector<scl::thread> threads;
+
+  for ([[maybe_unused]] auto _ : std::views::iota (0, 4))
+    threads.push_back (scl::thread (read_only_reader));
+
+  for (auto& t : threads)
+    t.join();
+
+  // Joined so the write is ordered after every read
+  read_only.write()->clear();
+}
+
+// Synchronisation the checker can't see is described with a sync_clock
+checked_vector released;
+scl::sync_clock released_clock;
+std::atomic<bool> ready { false };
+
+void release_with_atomic()
+{
+  released.write()->push_back (1);
+  released_clock.release();
+  ready.store (true, std::memory_order_release);
+}
+
+void test_sync_clock()
+{
+  std::thread t (release_with_atomic);
+
+  while (! ready.load (std::memory_order_acquire))
+    std::this_thread::yield();
+
+  released_clock.acquire();
+  released.write()->push_back (2);
+  t.join();
+}
+
+// A new object at a destroyed object's address mustn't inherit its
+// accesses, even though nothing orders the two threads
+void test_reused_address()
+{
+  using registry = scl::data_race_registry<scl::happens_before_check_state>;
+  static int object = 0;
+
+  auto write_then_destroy = []
+  {
+    registry::on_write_started (&object);
+    registry::on_write_ended (&object);
+    registry::on_destroy (&object);
+  };
+
+  std::thread first (write_then_destroy);
+  first.join();
+
+  std::thread second (write_then_destroy);
+  second.join();
+}
+
+int main()
+{
+  test_thread_start_and_join();
+  test_task_scope();
+  test_synchronized_value();
+  test_unordered_reads();
+  test_sync_clock();
+  test_reused_address();
+}
@@ -0,0 +1,94 @@
+#include <print>
+
+// Use exit(1) as ctest seems to count a raised signal as a pass...
+#define DATA_RACE_DETECTED { std::println ("ERROR: data race detected"); std::exit(1); }
+#define DATA_RACE_LOCKSET 1
+#include "data_race_checker.h"
+#include "../synchronized_value.h"
+#include <cassert>
+#include <ranges>
+#include <thread>
+#include <vector>
+
+struct counter
+{
+  void increment() {
+    scl::scoped_check<scl::check_type::write, scl::lockset_check_state> _ (state);
+    ++value;
+  }
+
+  int get() {
+    scl::scoped_check<scl::check_type::read, scl::lockset_check_state> _ (state);
+    return value;
+  }
+
+  scl::lockset_check_state state;
+  int value = 0;
+};
+
+// Every access is under the same synchronized_value so it's consistently locked
+void test_consistent_lock()
+{
+  scl::synchronized_value<counter> c;
+
+  {
+    std::vector<std::jthread> threads;
+
+    for ([[maybe_unused]] auto _ : std::views::iota (0, 4))
+      threads.emplace_back ([&]
+                            {
+                              for ([[maybe_unused]] auto i : std::views::iota (0, 1'000))
+                                apply ([] (counter& v) { v.increment(); }, c);
+                            });
+  }
+
+  [[maybe_unused]] const auto locks = apply ([] (counter& v) { return candidate_locks (v.state); }, c);
+  assert(locks.size() == 1);
+
+  [[maybe_unused]] const auto total = apply ([] (counter& v) { return v.get(); }, c);
+  assert(total == 4'000);
+}
+
+// The creating thread can initialise an object without a lock before sharing it
+void test_unlocked_initialisation()
+{
+  counter shared;
+  scl::synchronized_value<int> guard;
+
+  for ([[maybe_unused]] auto i : std::views::iota (0, 10))
+    shared.increment();
+
+  std::thread t ([&]
+                 {
+                   apply ([&] (int&) { shared.increment(); }, guard);
+                 });
+  t.join();
+
+  apply ([&] (int&) { shared.increment(); }, guard);
+
+  [[maybe_unused]] const auto total = apply ([&] (int&) { return shared.get(); }, guard);
+  assert(total == 12);
+}
+
+// Reads from several threads without a lock aren't a race if nothing writes
+void test_unlocked_reads()
+{
+  counter read_only;
+  read_only.increment();
+
+  std::vector<std::jthread> threads;
+
+  for ([[maybe_unused]] auto _ : std::views::iota (0, 4))
+    threads.emplace_back ([&]
+                          {
+                            if (read_only.get() != 1)
+                              std::exit(1);
+                          });
+}
+
+int main()
+{
+  test_consistent_lock();
+  test_unlocked_initialisation();
+  test_unlocked_reads();
+}
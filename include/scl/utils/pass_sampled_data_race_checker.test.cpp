@@ -0,0 +1,44 @@
+#include <print>
+
+// Use exit(1) as ctest seems to count a raised signal as a pass...
+#define DATA_RACE_DETECTED { std::println ("ERROR: data race detected"); std::exit(1); }
+#define DATA_RACE_CHECK_LEVEL 1
+#include "data_race_checker.test.h"
+
+static_assert(scl::default_check_level == scl::check_level::sampled);
+static_assert(std::is_empty_v<scl::scoped_check<scl::check_type::write, scl::check_state, scl::check_level::off>>);
+
+// Nesting deeper than the per-thread record of sampled starts mustn't
+// unbalance the state
+void test_deep_nesting()
+{
+  using registry = scl::data_race_registry<>;
+  int object = 0;
+
+  for ([[maybe_unused]] auto _ : std::ranges::iota_view (0, 100))
+    registry::on_write_started (&object);
+
+  for ([[maybe_unused]] auto _ : std::ranges::iota_view (0, 100))
+    registry::on_write_ended (&object);
+
+  if (! can_read (registry::get_state (&object)) || ! can_write (registry::get_state (&object)))
+    std::exit (1);
+
+  registry::on_destroy (&object);
+}
+
+int main()
+{
+  test_no_data_race();
+  test_no_data_race_read_read();
+
+  // Single threaded-tests, unsampled nested checks mustn't unbalance the state
+  for ([[maybe_unused]] auto _ : std::ranges::iota_view (0, 1'000))
+  {
+    test_no_data_race_read_write();
+    test_no_data_race_write_read();
+    test_no_data_race_write_write();
+  }
+
+  test_deep_nesting();
+}
@@ -0,0 +1,117 @@
+#include <atomic>
+#include <chrono>
+#include <print>
+#include <ranges>
+#include <thread>
+#include <vector>
+#include "reclamation.h"
+
+// Measures the read-side cost of each scheme: a reader repeatedly loads a
+// shared pointer and reads through it while a writer keeps replacing it
+
+struct node
+{
+    int value = 0;
+};
+
+constexpr std::size_t num_reads = 10'000'000;
+
+template<typename Fn>
+double time_ns_per_read (Fn&& fn)
+{
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now() - start).count() / num_reads;
+}
+
+template<typename RetireFn>
+std::jthread start_writer (std::atomic<node*>& shared, RetireFn&& retire)
+{
+    return std::jthread ([&shared, retire] (std::stop_token st)
+                         {
+                             for (int i = 0; ! st.stop_requested(); ++i)
+                             {
+                                 retire (shared.exchange (new node { i }));
+                                 std::this_thread::yield();
+                             }
+                         });
+}
+
+int main()
+{
+    long long sum = 0;
+
+    // Baseline with no reclamation, nodes are leaked until the end
+    const auto unprotected = [&]
+    {
+        std::atomic<node*> shared { new node() };
+        std::vector<node*> leaked;
+        std::atomic<bool> done { false };
+        std::jthread writer ([&] (std::stop_token st)
+                             {
+                                 while (! st.stop_requested())
+                                 {
+                                     leaked.push_back (shared.exchange (new node()));
+                                     std::this_thread::yield();
+                                 }
+                             });
+
+        const auto ns = time_ns_per_read ([&]
+                                          {
+                                              for ([[maybe_unused]] auto i : std::views::iota (0uz, num_reads))
+                                                  sum += shared.load (std::memory_order_acquire)->value;
+                                          });
+        writer.request_stop();
+        writer.join();
+
+        for (auto n : leaked)
+            delete n;
+
+        delete shared.load();
+        return ns;
+    }();
+
+    const auto epoch = [&]
+    {
+        scl::epoch_domain domain;
+        std::atomic<node*> shared { new node() };
+        auto writer = start_writer (shared, [&] (node* n) { auto g = domain.pin(); domain.retire (n); });
+
+        const auto ns = time_ns_per_read ([&]
+                                          {
+                                              for ([[maybe_unused]] auto i : std::views::iota (0uz, num_reads))
+                                              {
+                                                  auto guard = domain.pin();
+                                                  sum += shared.load (std::memory_order_acquire)->value;
+                                              }
+                                          });
+        writer.request_stop();
+        writer.join();
+        delete shared.load();
+        return ns;
+    }();
+
+    const auto hazard = [&]
+    {
+        scl::hazard_domain domain;
+        std::atomic<node*> shared { new node() };
+        auto writer = start_writer (shared, [&] (node* n) { domain.retire (n); });
+        auto guard = domain.make_guard();
+
+        const auto ns = time_ns_per_read ([&]
+                                          {
+                                              for ([[maybe_unused]] auto i : std::views::iota (0uz, num_reads))
+                                                  sum += guard.protect (shared)->value;
+                                          });
+        guard.reset();
+        writer.request_stop();
+        writer.join();
+        delete shared.load();
+        return ns;
+    }();
+
+    std::println ("{} reads with a concurrent writer (checksum {})", num_reads, sum);
+    std::println ("unprotected: {:6.2f} ns/read", unprotected);
+    std::println ("epoch:       {:6.2f} ns/read", epoch);
+    std::println ("hazard:      {:6.2f} ns/read", hazard);
+}
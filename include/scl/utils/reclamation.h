@@ -0,0 +1,516 @@
+#pragma once
+
+#include "cache_line.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Safe memory reclamation for lock-free data structures.
+//
+// When a node is unlinked from a lock-free structure, other threads may still
+// be reading it so it can't be deleted straight away. Instead it is "retired"
+// and deleted once no thread can hold a reference to it.
+//
+// Two schemes are provided:
+// - epoch_domain: Readers "pin" the current epoch for the duration of an
+//   operation. This is very cheap for readers (one seq_cst exchange per
+//   operation, not per node) but a stalled reader prevents any reclamation.
+// - hazard_domain: Readers publish a "hazard pointer" for each node they are
+//   about to access. This costs a store and fence per node but bounds the
+//   number of unreclaimed nodes, even if a reader stalls.
+//
+// Both keep a retire list per thread so retiring never contends with other
+// threads. Any nodes still retired are deleted when the domain is destroyed.
+
+namespace scl {
+
+namespace detail {
+struct retired_object
+{
+    void* pointer;
+    void (*deleter) (void*);
+    std::uint64_t epoch = 0;
+
+    void reclaim() const { deleter (pointer); }
+};
+
+template<typename T>
+void delete_retired (void* p)
+{
+    delete static_cast<T*> (p);
+}
+
+struct reclamation_cache
+{
+    std::uint64_t instance = 0;
+    void* record = nullptr;
+};
+
+inline std::uint64_t next_reclamation_instance()
+{
+    static std::atomic<std::uint64_t> next { 1 };
+    return next.fetch_add (1, std::memory_order_relaxed);
+}
+
+/** A lock-free list of records, one per thread that uses a domain. */
+template<typename Record>
+class thread_records
+{
+public:
+    ~thread_records()
+    {
+        for (auto r = head.load (std::memory_order_acquire); r;)
+            delete std::exchange (r, r->next);
+    }
+
+    Record& this_thread_record()
+    {
+        thread_local reclamation_cache cache;
+
+        if (cache.instance == instance)
+            return *static_cast<Record*> (cache.record);
+
+        auto r = find_or_create();
+        cache = { instance, r };
+        return *r;
+    }
+
+    template<typename F>
+    void for_each (F&& f) const
+    {
+        for (auto r = head.load (std::memory_order_acquire); r; r = r->next)
+            f (*r);
+    }
+
+private:
+    const std::uint64_t instance = next_reclamation_instance();
+    std::atomic<Record*> head { nullptr };
+
+    Record* find_or_create()
+    {
+        const auto this_thread_id = std::this_thread::get_id();
+
+        // acquire: see the contents of records pushed by other threads
+        for (auto r = head.load (std::memory_order_acquire); r; r = r->next)
+            if (r->owner == this_thread_id)
+                return r;
+
+        auto r = new Record (this_thread_id);
+        r->next = head.load (std::memory_order_relaxed);
+
+        // release: publish the new record's contents
+        while (! head.compare_exchange_weak (r->next, r, std::memory_order_release, std::memory_order_relaxed))
+        {}
+
+        return r;
+    }
+};
+}
+
+//==========================================
+//==========================================
+/**
+ *  Epoch based reclamation.
+ *
+ *  Threads pin the domain while they access shared nodes. Retired nodes are
+ *  tagged with the global epoch and the epoch only advances once every pinned
+ *  thread has seen it. Nodes retired two epochs ago can then no longer be
+ *  referenced and are deleted.
+ *
+ *  @code
+ *  {
+ *      auto guard = domain.pin();
+ *      auto n = head.load();
+ *      if (head.compare_exchange_strong (n, n->next))
+ *          domain.retire (n);
+ *  }
+ *  @endcode
+ */
+class epoch_domain
+{
+    struct record;
+
+public:
+    //==========================================
+    /** Keeps the calling thread pinned while alive. Guards can be nested. */
+    class guard
+    {
+    public:
+        guard (guard&& other) noexcept
+            : r (std::exchange (other.r, nullptr))
+        {}
+
+        guard& operator= (guard&&) = delete;
+
+        ~guard()
+        {
+            if (r)
+                unpin (*r);
+        }
+
+    private:
+        friend epoch_domain;
+
+        explicit guard (record& record_to_use)
+            : r (&record_to_use)
+        {}
+
+        record* r = nullptr;
+    };
+
+    //==========================================
+    /** Creates a domain that tries to reclaim every collect_threshold retires. */
+    explicit epoch_domain (std::size_t collect_threshold = 64)
+        : threshold (collect_threshold)
+    {}
+
+    epoch_domain (const epoch_domain&) = delete;
+    epoch_domain& operator= (const epoch_domain&) = delete;
+
+    /** Deletes everything still retired. No threads should be pinned. */
+    ~epoch_domain()
+    {
+        records.for_each ([] (record& r)
+                          {
+                              for (auto& o : r.retired)
+                                  o.reclaim();
+                          });
+    }
+
+    /** Pins the calling thread to the current epoch. */
+    [[nodiscard]] guard pin()
+    {
+        auto& r = records.this_thread_record();
+
+        if (r.nesting++ == 0)
+        {
+            // seq_cst: the announcement must be visible before reading any shared nodes.
+            // An exchange is cheaper than a store followed by a fence on most platforms
+            r.state.exchange ((global_epoch.load (std::memory_order_relaxed) << 1) | active_flag,
+                              std::memory_order_seq_cst);
+        }
+
+        return guard (r);
+    }
+
+    /** Deletes p once no thread can be accessing it. */
+    template<typename T>
+    void retire (T* p)
+    {
+        retire (p, &detail::delete_retired<T>);
+    }
+
+    void retire (void* p, void (*deleter) (void*))
+    {
+        auto& r = records.this_thread_record();
+
+        // seq_cst: p has been unlinked so any thread pinned to an earlier
+        // epoch than the one read here could still be accessing it
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+        r.retired.push_back ({ p, deleter, global_epoch.load (std::memory_order_relaxed) });
+
+        if (r.retired.size() >= r.next_collect)
+        {
+            collect (r);
+            r.next_collect = r.retired.size() + threshold;
+        }
+    }
+
+    /** Tries to advance the epoch and deletes the calling thread's nodes that
+        are safe to reclaim.
+    */
+    void collect()
+    {
+        collect (records.this_thread_record());
+    }
+
+    std::uint64_t epoch() const
+    {
+        return global_epoch.load (std::memory_order_relaxed);
+    }
+
+    /** Returns the number of nodes retired but not yet deleted. */
+    std::size_t num_retired() const
+    {
+        std::size_t num = 0;
+        records.for_each ([&] (const record& r) { num += r.retired.size(); });
+        return num;
+    }
+
+private:
+    static constexpr std::uint64_t active_flag = 1;
+
+    struct alignas (cache_line_size) record
+    {
+        explicit record (std::thread::id id)
+            : owner (id)
+        {}
+
+        const std::thread::id owner;
+        record* next = nullptr;
+        std::atomic<std::uint64_t> state { 0 };    // (epoch << 1) | active
+
+        // Owner thread only
+        std::size_t nesting = 0;
+        std::vector<detail::retired_object> retired;
+        std::size_t next_collect = 0;
+    };
+
+    const std::size_t threshold;
+    detail::thread_records<record> records;
+    alignas (cache_line_size) std::atomic<std::uint64_t> global_epoch { 0 };
+
+    static void unpin (record& r)
+    {
+        // release: all reads of shared nodes happen before leaving
+        if (--r.nesting == 0)
+            r.state.store (0, std::memory_order_release);
+    }
+
+    bool try_advance()
+    {
+        auto epoch = global_epoch.load (std::memory_order_relaxed);
+
+        // seq_cst: pairs with the fence in pin
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+        bool all_caught_up = true;
+
+        records.for_each ([&] (const record& r)
+                          {
+                              const auto s = r.state.load (std::memory_order_acquire);
+
+                              if ((s & active_flag) && (s >> 1) != epoch)
+                                  all_caught_up = false;
+                          });
+
+        return all_caught_up
+            && global_epoch.compare_exchange_strong (epoch, epoch + 1, std::memory_order_acq_rel);
+    }
+
+    void collect (record& r)
+    {
+        try_advance();
+
+        // acquire: the advance happened after every reader left the old epoch
+        const auto safe_epoch = global_epoch.load (std::memory_order_acquire);
+        const auto reclaimable = std::ranges::partition (r.retired,
+                                                         [&] (auto& o) { return o.epoch + 2 > safe_epoch; });
+
+        for (auto& o : reclaimable)
+            o.reclaim();
+
+        r.retired.erase (reclaimable.begin(), reclaimable.end());
+    }
+};
+
+
+//==========================================
+//==========================================
+/**
+ *  Hazard pointer based reclamation.
+ *
+ *  Before accessing a shared node a thread protects it with a guard, which
+ *  publishes the pointer. Retired nodes are only deleted once no guard holds
+ *  them.
+ *
+ *  @code
+ *  auto guard = domain.make_guard();
+ *  auto n = guard.protect (head);
+ *  if (head.compare_exchange_strong (n, n->next))
+ *  {
+ *      guard.reset();
+ *      domain.retire (n);
+ *  }
+ *  @endcode
+ */
+class hazard_domain
+{
+    struct hazard_record;
+
+public:
+    //==========================================
+    /** Owns a hazard pointer that can protect one node at a time. */
+    class guard
+    {
+    public:
+        guard (guard&& other) noexcept
+            : h (std::exchange (other.h, nullptr))
+        {}
+
+        guard& operator= (guard&&) = delete;
+
+        ~guard()
+        {
+            if (h)
+            {
+                reset();
+                h->in_use.store (false, std::memory_order_release);
+            }
+        }
+
+        /** Loads src and protects the result so it can't be reclaimed until
+            the guard is reset or destroyed.
+        */
+        template<typename T>
+        T* protect (const std::atomic<T*>& src)
+        {
+            auto p = src.load (std::memory_order_relaxed);
+
+            for (;;)
+            {
+                // seq_cst: the hazard must be visible before re-checking src
+                h->pointer.store (p, std::memory_order_seq_cst);
+                const auto current = src.load (std::memory_order_seq_cst);
+
+                if (current == p)
+                    return p;
+
+                p = current;
+            }
+        }
+
+        /** Stops protecting the current node, does nothing if moved from. */
+        void reset()
+        {
+            if (h)
+                h->pointer.store (nullptr, std::memory_order_release);
+        }
+
+    private:
+        friend hazard_domain;
+
+        explicit guard (hazard_record& record_to_use)
+            : h (&record_to_use)
+        {}
+
+        hazard_record* h = nullptr;
+    };
+
+    //==========================================
+    /** Creates a domain that scans the hazards every collect_threshold
+        retires (plus the number of hazard pointers).
+    */
+    explicit hazard_domain (std::size_t collect_threshold = 64)
+        : threshold (collect_threshold)
+    {}
+
+    hazard_domain (const hazard_domain&) = delete;
+    hazard_domain& operator= (const hazard_domain&) = delete;
+
+    /** Deletes everything still retired. No guards should be alive. */
+    ~hazard_domain()
+    {
+        retired_records.for_each ([] (retire_record& r)
+                                  {
+                                      for (auto& o : r.retired)
+                                          o.reclaim();
+                                  });
+
+        for (auto h = hazards.load (std::memory_order_acquire); h;)
+            delete std::exchange (h, h->next);
+    }
+
+    /** Returns a guard using an unused hazard pointer, creating one if needed. */
+    [[nodiscard]] guard make_guard()
+    {
+        for (auto h = hazards.load (std::memory_order_acquire); h; h = h->next)
+            if (! h->in_use.load (std::memory_order_relaxed)
+                && ! h->in_use.exchange (true, std::memory_order_acquire))
+                return guard (*h);
+
+        auto h = new hazard_record();
+        h->in_use.store (true, std::memory_order_relaxed);
+        h->next = hazards.load (std::memory_order_relaxed);
+
+        while (! hazards.compare_exchange_weak (h->next, h, std::memory_order_release, std::memory_order_relaxed))
+        {}
+
+        num_hazards.fetch_add (1, std::memory_order_relaxed);
+        return guard (*h);
+    }
+
+    /** Deletes p once no guard is protecting it. */
+    template<typename T>
+    void retire (T* p)
+    {
+        retire (p, &detail::delete_retired<T>);
+    }
+
+    void retire (void* p, void (*deleter) (void*))
+    {
+        auto& r = retired_records.this_thread_record();
+        r.retired.push_back ({ p, deleter });
+
+        if (r.retired.size() >= threshold + num_hazards.load (std::memory_order_relaxed))
+            collect (r);
+    }
+
+    /** Deletes any of the calling thread's retired nodes that aren't protected. */
+    void collect()
+    {
+        collect (retired_records.this_thread_record());
+    }
+
+    /** Returns the number of nodes retired but not yet deleted. */
+    std::size_t num_retired() const
+    {
+        std::size_t num = 0;
+        retired_records.for_each ([&] (const retire_record& r) { num += r.retired.size(); });
+        return num;
+    }
+
+private:
+    struct alignas (cache_line_size) hazard_record
+    {
+        std::atomic<const void*> pointer { nullptr };
+        std::atomic<bool> in_use { false };
+        hazard_record* next = nullptr;
+    };
+
+    struct retire_record
+    {
+        explicit retire_record (std::thread::id id)
+            : owner (id)
+        {}
+
+        const std::thread::id owner;
+        retire_record* next = nullptr;
+        std::vector<detail::retired_object> retired;  // Owner thread only
+    };
+
+    const std::size_t threshold;
+    std::atomic<hazard_record*> hazards { nullptr };
+    std::atomic<std::size_t> num_hazards { 0 };
+    detail::thread_records<retire_record> retired_records;
+
+    void collect (retire_record& r)
+    {
+        // seq_cst: pairs with the hazard publication in protect
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+
+        std::vector<const void*> protected_pointers;
+
+        for (auto h = hazards.load (std::memory_order_acquire); h; h = h->next)
+            if (auto p = h->pointer.load (std::memory_order_acquire))
+                protected_pointers.push_back (p);
+
+        std::ranges::sort (protected_pointers);
+
+        const auto reclaimable = std::ranges::partition (r.retired,
+                                                         [&] (auto& o)
+                                                         {
+                                                             return std::ranges::binary_search (protected_pointers,
+                                                                                                static_cast<const void*> (o.pointer));
+                                                         });
+
+        for (auto& o : reclaimable)
+            o.reclaim();
+
+        r.retired.erase (reclaimable.begin(), reclaimable.end());
+    }
+};
+
+}
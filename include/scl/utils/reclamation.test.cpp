@@ -0,0 +1,246 @@
+#include <atomic>
+#include <cassert>
+#include <ranges>
+#include <thread>
+#include <vector>
+#include "reclamation.h"
+
+struct counted_node
+{
+    explicit counted_node (int v)
+        : value (v)
+    {
+        num_alive.fetch_add (1, std::memory_order_relaxed);
+    }
+
+    ~counted_node()
+    {
+        num_alive.fetch_sub (1, std::memory_order_relaxed);
+    }
+
+    int value;
+    counted_node* next = nullptr;
+
+    static inline std::atomic<int> num_alive { 0 };
+};
+
+/** A Treiber stack, the classic structure that needs safe reclamation as a
+    popped node may still be being read by another popping thread.
+*/
+template<typename Domain>
+struct stack
+{
+    Domain& domain;
+    std::atomic<counted_node*> head { nullptr };
+
+    ~stack()
+    {
+        for (auto n = head.load(); n;)
+            delete std::exchange (n, n->next);
+    }
+
+    void push (int v)
+    {
+        auto n = new counted_node (v);
+        n->next = head.load (std::memory_order_relaxed);
+
+        while (! head.compare_exchange_weak (n->next, n, std::memory_order_release, std::memory_order_relaxed))
+        {}
+    }
+
+    bool pop (int& v)
+        requires std::same_as<Domain, scl::epoch_domain>
+    {
+        auto guard = domain.pin();
+        auto n = head.load (std::memory_order_acquire);
+
+        while (n && ! head.compare_exchange_weak (n, n->next, std::memory_order_acquire))
+        {}
+
+        if (! n)
+            return false;
+
+        v = n->value;
+        domain.retire (n);
+        return true;
+    }
+
+    bool pop (int& v)
+        requires std::same_as<Domain, scl::hazard_domain>
+    {
+        auto guard = domain.make_guard();
+
+        for (;;)
+        {
+            auto n = guard.protect (head);
+
+            if (! n)
+                return false;
+
+            if (head.compare_exchange_strong (n, n->next, std::memory_order_acquire))
+            {
+                guard.reset();
+                v = n->value;
+                domain.retire (n);
+                return true;
+            }
+        }
+    }
+};
+
+template<typename Domain>
+void test_concurrent_stack()
+{
+    constexpr int num_threads = 4, num_values = 20'000;
+
+    {
+        Domain domain;
+        stack<Domain> s { domain };
+        std::atomic<long long> popped_sum { 0 };
+        std::vector<std::thread> threads;
+
+        for (auto t : std::views::iota (0, num_threads))
+            threads.emplace_back ([&, t]
+                                  {
+                                      long long sum = 0;
+
+                                      for (auto i : std::views::iota (0, num_values))
+                                      {
+                                          s.push (t * num_values + i);
+
+                                          if (int v; s.pop (v))
+                                              sum += v;
+                                      }
+
+                                      popped_sum += sum;
+                                  });
+
+        for (auto& t : threads)
+            t.join();
+
+        // Each pop follows a push so everything is popped
+        [[maybe_unused]] const long long n = num_threads * num_values;
+        assert(popped_sum == n * (n - 1) / 2);
+        assert(s.head.load() == nullptr);
+
+        // Retired nodes are reclaimed as we go so only a bounded number remain
+        assert(domain.num_retired() < static_cast<std::size_t> (n));
+        assert(counted_node::num_alive == static_cast<int> (domain.num_retired()));
+    }
+
+    // Anything left is deleted with the domain
+    assert(counted_node::num_alive == 0);
+}
+
+void test_epoch_pinned_reader_blocks_reclamation()
+{
+    scl::epoch_domain domain (1);
+    auto n = new counted_node (42);
+
+    {
+        auto reader = domain.pin();
+        [[maybe_unused]] auto nested = domain.pin();
+
+        domain.retire (n);
+
+        for ([[maybe_unused]] auto i : std::views::iota (0, 10))
+            domain.collect();
+
+        // Can't advance two epochs past the retire while pinned
+        assert(n->value == 42);
+        assert(domain.num_retired() == 1);
+    }
+
+    domain.collect();
+    domain.collect();
+    assert(domain.num_retired() == 0);
+    assert(counted_node::num_alive == 0);
+}
+
+void test_hazard_protected_node_is_not_reclaimed()
+{
+    scl::hazard_domain domain (0);
+    std::atomic<counted_node*> shared { new counted_node (42) };
+
+    auto reader = domain.make_guard();
+    auto n = reader.protect (shared);
+    assert(n == shared.load());
+
+    shared = nullptr;
+    domain.retire (n);
+    domain.collect();
+
+    assert(n->value == 42);
+    assert(domain.num_retired() == 1);
+
+    reader.reset();
+    domain.collect();
+    assert(domain.num_retired() == 0);
+    assert(counted_node::num_alive == 0);
+
+    // Guards reuse released hazard pointers
+    {
+        auto other = domain.make_guard();
+    }
+
+    auto other = domain.make_guard();
+    other.protect (shared);
+}
+
+void test_moved_from_hazard_guard()
+{
+    scl::hazard_domain domain (0);
+    std::atomic<counted_node*> shared { new counted_node (7) };
+
+    auto from = domain.make_guard();
+    auto n = from.protect (shared);
+    auto to = std::move (from);
+
+    // Resetting or destroying the moved-from guard mustn't touch the hazard
+    from.reset();
+    shared = nullptr;
+    domain.retire (n);
+    domain.collect();
+    assert(domain.num_retired() == 1);
+
+    to.reset();
+    domain.collect();
+    assert(domain.num_retired() == 0);
+}
+
+void test_retire_from_many_threads()
+{
+    scl::epoch_domain domain;
+    std::vector<std::thread> threads;
+
+    for ([[maybe_unused]] auto t : std::views::iota (0, 4))
+        threads.emplace_back ([&]
+                              {
+                                  for ([[maybe_unused]] auto i : std::views::iota (0, 1'000))
+                                  {
+                                      auto guard = domain.pin();
+                                      domain.retire (new counted_node (i));
+                                  }
+                              });
+
+    for (auto& t : threads)
+        t.join();
+
+    // Other threads have exited so the calling thread can reclaim its own list
+    domain.collect();
+    domain.collect();
+    assert(domain.num_retired() <= 4'000);
+}
+
+int main()
+{
+    test_concurrent_stack<scl::epoch_domain>();
+    test_concurrent_stack<scl::hazard_domain>();
+    test_epoch_pinned_reader_blocks_reclamation();
+    test_hazard_protected_node_is_not_reclaimed();
+    test_moved_from_hazard_guard();
+    test_retire_from_many_threads();
+    assert(counted_node::num_alive == 0);
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include <atomic>
+
+std::atomic<int> num_races { 0 };
+
+// Count races rather than exit so exactly which accesses race can be checked
+#define DATA_RACE_DETECTED num_races.fetch_add (1);
+#include "data_race_checker.h"
+#include <cassert>
+#include <latch>
+#include <thread>
+
+using scl::check_type;
+
+/** Runs f on another thread and waits for it. */
+template<typename F>
+void on_other_thread (F&& f)
+{
+  std::thread t (std::forward<F> (f));
+  t.join();
+}
+
+// A thread reading during a write races once, the writer's nested write
+// afterwards is still recursion
+template<typename State>
+void test_nested_write_after_racing_read()
+{
+  num_races = 0;
+  State state;
+
+  write_started (state);
+  on_other_thread ([&]
+                   {
+                     read_started (state);
+                     read_ended (state);
+                   });
+  assert(num_races == 1);
+
+  write_started (state);
+  read_started (state);
+  read_ended (state);
+  write_ended (state);
+  write_ended (state);
+  assert(num_races == 1);
+}
+
+// Two threads reading then one nesting a write races with the other reader
+template<typename State>
+void test_write_nested_in_shared_read()
+{
+  num_races = 0;
+  State state;
+  std::latch read (1), written (1);
+
+  std::thread other ([&]
+                     {
+                       read_started (state);
+                       read.count_down();
+                       written.wait();
+                       read_ended (state);
+                     });
+
+  read.wait();
+  read_started (state);
+  write_started (state);
+  write_ended (state);
+  read_ended (state);
+  written.count_down();
+  other.join();
+
+  assert(num_races == 1);
+}
+
+// Once the other reader has left, a write nested in the remaining thread's
+// read is recursion, even though the state saw two readers at once
+template<typename State>
+void test_write_nested_in_read_after_other_reader_left()
+{
+  num_races = 0;
+  State state;
+  std::latch read (1), both_reading (1);
+
+  std::thread other ([&]
+                     {
+                       read_started (state);
+                       read.count_down();
+                       both_reading.wait();
+                       read_ended (state);
+                     });
+
+  read.wait();
+  read_started (state);
+  both_reading.count_down();
+  other.join();
+
+  write_started (state);
+  write_ended (state);
+  read_ended (state);
+
+  assert(num_races == 0);
+  assert(can_read (state) && can_write (state));
+}
+
+// Nested reads and writes on one thread never race
+template<typename State>
+void test_recursion()
+{
+  num_races = 0;
+  State state;
+
+  // push_back_2
+  write_started (state);
+  write_started (state);
+  write_ended (state);
+  write_started (state);
+  write_ended (state);
+  write_ended (state);
+
+  // push_back_return_old_back
+  write_started (state);
+  read_started (state);
+  read_ended (state);
+  write_started (state);
+  write_ended (state);
+  write_ended (state);
+
+  // back_with_default_write
+  read_started (state);
+  write_started (state);
+  write_ended (state);
+  read_ended (state);
+
+  assert(num_races == 0);
+  assert(can_read (state) && can_write (state));
+}
+
+template<typename State>
+void run()
+{
+  test_nested_write_after_racing_read<State>();
+  test_write_nested_in_shared_read<State>();
+  test_write_nested_in_read_after_other_reader_left<State>();
+  test_recursion<State>();
+}
+
+int main()
+{
+  run<scl::check_state>();
+  run<scl::striped_check_state<>>();
+  run<scl::striped_check_state<1>>();
+}
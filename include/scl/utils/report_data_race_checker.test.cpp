@@ -0,0 +1,63 @@
+#define DATA_RACE_REPORT
+#define DATA_RACE_LOG_FILE "report-data-race-violations.log"
+#include "data_race_checker.test.h"
+#include <cassert>
+#include <fstream>
+#include <string>
+
+void race_for (std::chrono::milliseconds duration)
+{
+  test_vector<size_t> vec;
+  std::atomic<bool> stop { false };
+  std::vector<std::thread> threads;
+
+  threads.emplace_back([&]
+                       {
+                         while (! stop)
+                         {
+                           for (auto c : std::ranges::iota_view (0uz, 100uz))
+                             vec.push_back (c);
+
+                           vec.clear();
+                         }
+                       });
+
+  for ([[maybe_unused]] auto _ : std::ranges::iota_view (0, 2))
+    threads.emplace_back([&]
+                         {
+                           while (! stop)
+                           {
+                             [[maybe_unused]] volatile auto c = vec.size();
+                           }
+                         });
+
+  std::this_thread::sleep_for (duration);
+  stop = true;
+
+  for (auto& t : threads)
+    t.join();
+}
+
+int main()
+{
+  // Races are reported and the threads carry on
+  race_for (std::chrono::milliseconds (200));
+
+  auto& log = scl::data_race_log::instance();
+  log.flush();
+  assert(log.num_reported() + log.num_dropped() > 0);
+
+  // Only the first race from each call site is written in full
+  std::ifstream file ("report-data-race-violations.log");
+  std::size_t num_lines = 0;
+
+  for (std::string line; std::getline (file, line);)
+  {
+    assert(line.starts_with ("data race: "));
+    ++num_lines;
+  }
+
+  assert(num_lines > 0);
+  assert(num_lines == log.num_call_sites());
+  assert(log.num_call_sites() < log.num_reported());
+}
@@ -0,0 +1,14 @@
+#include <scl/execution.h>
+
+namespace ex = scl::execution;
+
+int main()
+{
+    int value = 42;
+
+    // A raw pointer isn't send so can't move to another scheduler
+    auto s = ex::just (&value)
+           | ex::continues_on (ex::inline_scheduler());
+
+    ex::sync_wait (std::move (s));
+}
@@ -0,0 +1,10 @@
+#include <vector>
+#include <scl/isolated.h>
+
+int main()
+{
+    auto buffer = scl::make_isolated<std::vector<int>> (std::size_t (1024));
+
+    // A pointer in to the buffer would outlive the borrow
+    [[maybe_unused]] auto data = buffer.borrow ([] (std::vector<int>& v) { return v.data(); });
+}
@@ -0,0 +1,11 @@
+#include <span>
+#include <vector>
+#include <scl/isolated.h>
+
+int main()
+{
+    auto buffer = scl::make_isolated<std::vector<int>> (std::size_t (1024));
+
+    // A span is send but still refers in to the buffer after the borrow
+    [[maybe_unused]] auto data = buffer.borrow ([] (std::vector<int>& v) { return std::span (v); });
+}
@@ -0,0 +1,11 @@
+#include <array>
+#include <span>
+#include <scl/isolated.h>
+
+int main()
+{
+    std::array<int, 4> local {};
+
+    // A span is send but would leave the array aliased on this thread
+    [[maybe_unused]] auto view = scl::isolated<std::span<int>> (std::span<int> (local));
+}
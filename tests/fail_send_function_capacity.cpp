@@ -0,0 +1,17 @@
+#include <scl/send_function.h>
+
+struct big_task
+{
+    void operator()() {}
+    char data[128];
+};
+
+template<>
+struct scl::is_send<big_task> : std::true_type {};
+
+int main()
+{
+    // A callable bigger than the inline Capacity can't be stored
+    scl::send_function<void(), 64> f (big_task {});
+    f();
+}
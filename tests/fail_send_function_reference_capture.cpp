@@ -0,0 +1,15 @@
+#include <print>
+#include <vector>
+#include <scl/send_function.h>
+
+int main()
+{
+    std::vector<scl::send_function<void()>> tasks;
+    int mol = 42;
+
+    // References can't be sent to the thread that will run the task
+    tasks.emplace_back ([&mol] { std::println ("Hello send_function {}", mol); });
+
+    for (auto& t : tasks)
+        t();
+}
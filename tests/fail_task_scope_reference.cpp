@@ -0,0 +1,19 @@
+#include <print>
+#include <ranges>
+#include <scl/task_scope.h>
+
+void entry_point (int& tid)
+{
+    std::println ("{}", tid++);
+}
+
+int main()
+{
+    int shared = 0;
+
+    // int isn't sync so can't be borrowed, even by a scope
+    scl::task_scope scope;
+
+    for ([[maybe_unused]] int i : std::views::iota (0, 15))
+        scope.spawn (entry_point, shared);
+}
@@ -0,0 +1,26 @@
+#include <print>
+#include <ranges>
+#include <string>
+#include <scl/synchronized_value.h>
+#include <scl/task_scope.h>
+
+void entry_point (scl::synchronized_value<std::string>& sync_s, int tid)
+{
+    apply ( [tid] (auto& s) {
+        s.append ("🔥");
+        std::println ("{} {}", s, tid);
+        return s;
+    },
+    sync_s);
+}
+
+int main()
+{
+    // No need for a shared_ptr, the scope joins before s is destroyed
+    scl::synchronized_value<std::string> s ("Hello threads");
+
+    scl::task_scope scope;
+
+    for (int i : std::views::iota (0, 15))
+        scope.spawn (entry_point, s, auto (i));
+}